@@ -72,7 +72,12 @@
 #define configSUPPORT_STATIC_ALLOCATION 0
 #define configSUPPORT_DYNAMIC_ALLOCATION 1
 #define configTOTAL_HEAP_SIZE (32 * 1024)
+/* The banked canvas build places the heap next to the canvas, see main.c */
+#if defined(VGA_BANKED_CANVAS) && VGA_BANKED_CANVAS
+#define configAPPLICATION_ALLOCATED_HEAP 1
+#else
 #define configAPPLICATION_ALLOCATED_HEAP 0
+#endif
 
 /* Hook function related definitions. */
 #define configCHECK_FOR_STACK_OVERFLOW 0
@@ -80,9 +85,19 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK 0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS 0
+#define configGENERATE_RUN_TIME_STATS 1
 #define configUSE_TRACE_FACILITY 1
-#define configUSE_STATS_FORMATTING_FUNCTIONS 0
+#define configUSE_STATS_FORMATTING_FUNCTIONS 0 /* stats.c emits its own CSV */
+
+/* The RP2040 timer already counts microseconds since boot, so the run time
+counter needs no setup and a 64 bit count never wraps. */
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+extern uint64_t time_us_64(void);
+#endif
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() time_us_64()
 
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES 0
@@ -103,9 +118,11 @@ processor and application]
 */
 
 /* SMP port only */
-#define configNUMBER_OF_CORES 1
-#define configTICK_CORE 1
+#define configNUMBER_OF_CORES 2
+#define configTICK_CORE 0
 #define configRUN_MULTIPLE_PRIORITIES 1
+#define configUSE_CORE_AFFINITY 1
+#define configUSE_PASSIVE_IDLE_HOOK 0
 
 /* RP2040 specific */
 #define configSUPPORT_PICO_SYNC_INTEROP 1
@@ -136,4 +153,15 @@ to exclude the API function. */
 
 /* A header file that defines trace macro can be included here. */
 
+/* Task switches go into the per-core trace ring, see src/trace.h. These
+macros expand inside tasks.c, where pxCurrentTCB is visible. */
+#ifndef __ASSEMBLER__
+void trace_task_switched_in(unsigned int task_number);
+void trace_task_switched_out(unsigned int task_number);
+#endif
+#define traceTASK_SWITCHED_IN()                                                \
+  trace_task_switched_in(pxCurrentTCB->uxTCBNumber)
+#define traceTASK_SWITCHED_OUT()                                               \
+  trace_task_switched_out(pxCurrentTCB->uxTCBNumber)
+
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,187 @@
+// Blend microbenchmark. Runs the two-pixel SWAR spans from blend.c and a
+// naive unpack-per-channel version over a full canvas, checks that both give
+// the same pixels and reports Mpixels/s for each.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blend.h"
+#include "sim_setup.h"
+
+#define BENCH_DEFAULT_FRAMES 2000u
+#define BENCH_PIXELS (SIM_CANVAS_WIDTH * SIM_CANVAS_HEIGHT)
+#define BENCH_ALPHA 12
+
+static uint16_t src[BENCH_PIXELS];
+static uint16_t dest[BENCH_PIXELS];
+static uint16_t check[BENCH_PIXELS];
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// -------- Naive --------
+
+static uint channel(uint16_t pixel, uint shift) {
+  return (pixel >> shift) & 31;
+}
+
+static uint16_t pack(uint r, uint g, uint b) {
+  return (uint16_t)(r << BLEND_R_SHIFT | g << BLEND_G_SHIFT |
+                    b << BLEND_B_SHIFT);
+}
+
+static void naive_alpha_span(uint16_t *d, const uint16_t *s, uint count,
+                             uint alpha) {
+  uint inv = BLEND_ALPHA_MAX - alpha;
+  for (uint i = 0; i < count; i++) {
+    uint r = (channel(s[i], BLEND_R_SHIFT) * alpha +
+              channel(d[i], BLEND_R_SHIFT) * inv) >>
+             5;
+    uint g = (channel(s[i], BLEND_G_SHIFT) * alpha +
+              channel(d[i], BLEND_G_SHIFT) * inv) >>
+             5;
+    uint b = (channel(s[i], BLEND_B_SHIFT) * alpha +
+              channel(d[i], BLEND_B_SHIFT) * inv) >>
+             5;
+    d[i] = pack(r, g, b);
+  }
+}
+
+static void naive_add_span(uint16_t *d, const uint16_t *s, uint count) {
+  for (uint i = 0; i < count; i++) {
+    uint r = channel(s[i], BLEND_R_SHIFT) + channel(d[i], BLEND_R_SHIFT);
+    uint g = channel(s[i], BLEND_G_SHIFT) + channel(d[i], BLEND_G_SHIFT);
+    uint b = channel(s[i], BLEND_B_SHIFT) + channel(d[i], BLEND_B_SHIFT);
+    d[i] = pack(MIN(r, 31u), MIN(g, 31u), MIN(b, 31u));
+  }
+}
+
+static void naive_fade_span(uint16_t *d, uint count, uint16_t color,
+                            uint alpha) {
+  for (uint i = 0; i < count; i++) {
+    uint16_t s = color;
+    naive_alpha_span(&d[i], &s, 1, alpha);
+  }
+}
+
+// -------- Naive --------
+
+// -------- Operations --------
+
+// Every operation works row by row over the whole canvas, starting one pixel
+// in so the odd leading and trailing pixels are exercised too
+static void op_alpha(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    blend_alpha_span(&d[row + 1], &src[row + 1], SIM_CANVAS_WIDTH - 2,
+                     BENCH_ALPHA);
+  }
+}
+
+static void op_alpha_naive(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    naive_alpha_span(&d[row + 1], &src[row + 1], SIM_CANVAS_WIDTH - 2,
+                     BENCH_ALPHA);
+  }
+}
+
+static void op_add(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    blend_add_span(&d[row + 1], &src[row + 1], SIM_CANVAS_WIDTH - 2);
+  }
+}
+
+static void op_add_naive(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    naive_add_span(&d[row + 1], &src[row + 1], SIM_CANVAS_WIDTH - 2);
+  }
+}
+
+static void op_fade(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    blend_fade_span(&d[row + 1], SIM_CANVAS_WIDTH - 2, 0x1234, BENCH_ALPHA);
+  }
+}
+
+static void op_fade_naive(uint16_t *d) {
+  for (uint y = 0; y < SIM_CANVAS_HEIGHT; y++) {
+    uint row = y * SIM_CANVAS_WIDTH;
+    naive_fade_span(&d[row + 1], SIM_CANVAS_WIDTH - 2, 0x1234, BENCH_ALPHA);
+  }
+}
+
+// -------- Operations --------
+
+struct bench_op {
+  const char *name;
+  void (*swar)(uint16_t *d);
+  void (*naive)(uint16_t *d);
+};
+
+static const struct bench_op ops[] = {
+    {"alpha", op_alpha, op_alpha_naive},
+    {"add", op_add, op_add_naive},
+    {"fade", op_fade, op_fade_naive},
+};
+
+static double mpixels_per_s(void (*op)(uint16_t *d), uint32_t frames) {
+  uint64_t start_ns = now_ns();
+  for (uint32_t i = 0; i < frames; i++) {
+    op(dest);
+  }
+  uint64_t elapsed_ns = now_ns() - start_ns;
+  return (double)frames * BENCH_PIXELS * 1e3 / (double)elapsed_ns;
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = BENCH_DEFAULT_FRAMES;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      frames = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Random pixels with the unused bit 5 clear, as the canvas holds them
+  srand(1);
+  for (uint i = 0; i < BENCH_PIXELS; i++) {
+    src[i] = (uint16_t)rand() & 0xffdf;
+    check[i] = (uint16_t)rand() & 0xffdf;
+  }
+
+  bool exact = true;
+  printf("%-8s %12s %12s %8s\n", "op", "SWAR Mpx/s", "naive Mpx/s", "pixels");
+  for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+    const struct bench_op *op = &ops[o];
+
+    memcpy(dest, check, sizeof(dest));
+    op->swar(dest);
+    static uint16_t expected[BENCH_PIXELS];
+    memcpy(expected, check, sizeof(expected));
+    op->naive(expected);
+    bool same = memcmp(dest, expected, sizeof(dest)) == 0;
+    exact &= same;
+
+    double swar = mpixels_per_s(op->swar, frames);
+    double naive = mpixels_per_s(op->naive, frames);
+    printf("%-8s %12.1f %12.1f %8s\n", op->name, swar, naive,
+           same ? "same" : "DIFFER");
+  }
+
+  return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
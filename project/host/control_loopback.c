@@ -0,0 +1,193 @@
+// Control protocol loopback over a pty. Plays the device side of control.h
+// with the same decoder and packet handler the firmware uses, runs the given
+// client on the pty's slave end and exits with the client's status:
+//
+//   control_loopback python3 tools/control.py {} compare --count 50
+//
+// A {} argument is replaced by the slave's path. Inputs are answered at the
+// next simulated logic tick, so the client sees the same waiting it would on
+// the device.
+#define _DEFAULT_SOURCE // cfmakeraw()
+#define _XOPEN_SOURCE 600
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "usb_stream.h"
+
+#define LOOPBACK_TICK_US 33000 // mainLOGIC_PERIOD_MS
+#define LOOPBACK_GAMES 2
+
+static int master = -1;
+
+static uint32_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000);
+}
+
+// Same framing as usb_stream_write(), straight to the pty
+static void send_frame(uint8_t channel, const void *data, uint16_t len) {
+  uint8_t frame[USB_STREAM_MAX_PAYLOAD + 5];
+
+  frame[0] = USB_STREAM_SYNC;
+  frame[1] = channel;
+  frame[2] = (uint8_t)len;
+  frame[3] = (uint8_t)(len >> 8);
+  memcpy(&frame[4], data, len);
+
+  uint8_t checksum = 0;
+  for (uint i = 1; i < 4u + len; i++) {
+    checksum ^= frame[i];
+  }
+  frame[4 + len] = checksum;
+
+  if (write(master, frame, len + 5u) != len + 5) {
+    perror("write");
+  }
+}
+
+static void reply(const struct control_packet *packet, uint8_t status,
+                  int32_t value) {
+  struct control_reply r = {
+      .type = packet->type,
+      .seq = packet->seq,
+      .status = status,
+      .arg = packet->arg,
+      .value = value,
+      .time_us = now_us(),
+  };
+  send_frame(USB_STREAM_CONTROL, &r, sizeof(r));
+}
+
+// -------- Device stand-in --------
+
+// Only the hooks are simulated, packets go through the firmware's
+// control_handle() and control_poll()
+
+static uint32_t started_at;
+static uint32_t tick_us = LOOPBACK_TICK_US;
+static int32_t game;
+
+static uint32_t ticks(void) { return (now_us() - started_at) / tick_us; }
+
+static uint8_t set(uint8_t param, int16_t value) {
+  if (param == CONTROL_PARAM_GAME && value >= 0 && value < LOOPBACK_GAMES) {
+    game = value;
+  } else if (param == CONTROL_PARAM_TICK_MS && value >= 5 && value <= 200) {
+    tick_us = (uint32_t)value * 1000;
+  } else {
+    return CONTROL_BAD_ARG;
+  }
+  return CONTROL_OK;
+}
+
+static uint8_t get(uint8_t state, int32_t *value) {
+  switch (state) {
+  case CONTROL_STATE_TICKS:
+    *value = (int32_t)ticks();
+    return CONTROL_OK;
+  case CONTROL_STATE_GAME:
+    *value = game;
+    return CONTROL_OK;
+  case CONTROL_STATE_LATENCY_IR:
+  case CONTROL_STATE_LATENCY_USB:
+    *value = 0; // Nothing is drawn here
+    return CONTROL_OK;
+  default:
+    return CONTROL_BAD_ARG;
+  }
+}
+
+// The command itself goes nowhere, only its arrival time matters
+static void input(uint8_t command) { (void)command; }
+
+static struct control_device device = {
+    .reply = reply,
+    .set = set,
+    .get = get,
+    .input = input,
+    .now_us = now_us,
+};
+
+// -------- Device stand-in --------
+
+static int open_pty(char *slave_path, size_t size) {
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    return -1;
+  }
+  snprintf(slave_path, size, "%s", ptsname(master));
+
+  // Raw before the client shows up, so nothing is echoed or translated.
+  // Kept open so the master does not see a hangup between client opens.
+  int slave = open(slave_path, O_RDWR | O_NOCTTY);
+  struct termios tio;
+  if (slave < 0 || tcgetattr(slave, &tio)) {
+    return -1;
+  }
+  cfmakeraw(&tio);
+  return tcsetattr(slave, TCSANOW, &tio);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <client> [args with {} for the pty...]\n",
+            argv[0]);
+    return 2;
+  }
+
+  char slave_path[64];
+  if (open_pty(slave_path, sizeof(slave_path))) {
+    perror("pty");
+    return 1;
+  }
+
+  pid_t client = fork();
+  if (client == 0) {
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "{}") == 0) {
+        argv[i] = slave_path;
+      }
+    }
+    execvp(argv[1], &argv[1]);
+    perror(argv[1]);
+    _exit(127);
+  }
+
+  started_at = now_us();
+  struct control_decoder decoder = {0};
+
+  for (;;) {
+    int status;
+    if (waitpid(client, &status, WNOHANG) == client) {
+      return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+
+    struct pollfd pfd = {.fd = master, .events = POLLIN};
+    if (poll(&pfd, 1, 1) > 0 && (pfd.revents & POLLIN)) {
+      uint8_t buf[256];
+      ssize_t got = read(master, buf, sizeof(buf));
+      for (ssize_t i = 0; i < got; i++) {
+        struct control_packet packet;
+        if (control_decode(&decoder, buf[i], &packet)) {
+          control_handle(&device, &packet);
+        }
+      }
+    }
+
+    // The input is used by the first tick that starts after it arrived
+    if (device.input_state == CONTROL_INPUT_WAITING &&
+        ticks() != (device.received_at - started_at) / tick_us) {
+      control_input_used(&device);
+    }
+    control_poll(&device);
+  }
+}
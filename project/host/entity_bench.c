@@ -0,0 +1,80 @@
+// Entity store benchmark. Runs the device game logic with the scripted input
+// at a range of ball counts and reports ns per tick, ns per entity and the
+// cost of every ball past the first, the host side of the device's
+// PONG_REPORT_TICK_COST figures.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "sim_setup.h"
+
+#define BENCH_DEFAULT_TICKS 100000u
+#define BENCH_SEED 1
+
+static const uint16_t ball_counts[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ns per tick with `balls` balls in play
+static double bench_run(uint16_t balls, uint32_t ticks, uint32_t *hash) {
+  static struct game_state gs;
+  sim_setup_state(&gs, balls, BENCH_SEED);
+
+  uint64_t start_ns = now_ns();
+  for (uint32_t tick = 0; tick < ticks; tick++) {
+    gs_tick(&gs, sim_scripted_input(&gs, tick));
+    gs.reset_score = false; // Normally cleared by the draw task
+  }
+  uint64_t elapsed_ns = now_ns() - start_ns;
+
+  // Keeps the work observable, and a behaviour change shows up here first
+  *hash = gs_hash(&gs);
+  return (double)elapsed_ns / (double)ticks;
+}
+
+int main(int argc, char **argv) {
+  uint32_t ticks = BENCH_DEFAULT_TICKS;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      ticks = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n ticks]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (ticks == 0) {
+    fprintf(stderr, "%s: -n must be at least 1\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%6s %9s %12s %12s %12s\n", "balls", "entities", "ns/tick",
+         "ns/entity", "ns/ball");
+  double single = 0;
+  for (size_t i = 0; i < sizeof(ball_counts) / sizeof(ball_counts[0]); i++) {
+    uint16_t balls = ball_counts[i];
+    uint16_t entities = GAME_ENTITY_BALL + balls;
+    uint32_t hash;
+    double ns = bench_run(balls, ticks, &hash);
+    if (balls == 1) {
+      single = ns;
+      printf("%6u %9u %12.1f %12.1f %12s   hash 0x%08x\n", balls, entities,
+             ns, ns / entities, "-", hash);
+    } else {
+      // What each ball past the first adds to the tick
+      printf("%6u %9u %12.1f %12.1f %12.1f   hash 0x%08x\n", balls, entities,
+             ns, ns / entities, (ns - single) / (balls - 1), hash);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+// Lockstep link test. Forks two headless Pong instances that play each other
+// through lockstep.c over a socket pair, the stand-in for the UART. Each side
+// delays its packets and drops some of them on the way out. Once both have
+// confirmed the same tick, their state hashes are compared with each other
+// and with a plain run of gs_tick_versus() fed the same scripted inputs, so
+// any rollback mistake shows up as a mismatch.
+//
+//   lockstep_sim -t 3000 -d 40 -l 20
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "lockstep.h"
+#include "sim_setup.h"
+
+#define SIM_DEFAULT_TICKS 3000u
+#define SIM_DEFAULT_DELAY_MS 30
+#define SIM_DEFAULT_LOSS 10       // Percent of packets dropped
+#define SIM_DEFAULT_PERIOD_US 2000 // Faster than the device's 33 ms
+#define SIM_LINGER_US 500000       // Keep answering after finishing
+#define SIM_TIMEOUT_US 120000000u
+#define SIM_QUEUE 1024 // Packets in flight per direction
+
+struct sim_options {
+  uint32_t ticks;
+  uint32_t delay_us;
+  uint32_t loss;
+  uint32_t period_us;
+  uint32_t seed;
+};
+
+// What a side reports to the parent
+struct sim_result {
+  uint32_t nonce;
+  uint32_t side;
+  uint32_t hash; // Of the confirmed state after opt.ticks ticks
+  bool finished;
+  bool desync;
+  uint32_t desync_tick;
+  bool lost;
+  uint32_t rollbacks;
+  uint32_t resimulated;
+  uint32_t stalls;
+  uint32_t sent;
+  uint32_t dropped;
+};
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint32_t mix(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// Input of `side` for the tick it is given on. Only depends on the tick, so
+// the reference run can reproduce it.
+static uint8_t sim_script(uint side, uint32_t tick) {
+  if (side == LOCKSTEP_LEFT && tick % 997 == 500) {
+    return GS_INPUT_MULTI_BALL;
+  }
+  if (side == LOCKSTEP_LEFT && tick % 997 == 900) {
+    return GS_INPUT_SINGLE_BALL;
+  }
+
+  // Holds a direction for a few ticks at a time, like a thumb on a key
+  switch (mix(side * 0x9e3779b9u + tick / 6) % 3) {
+  case 1:
+    return GS_INPUT_UP;
+  case 2:
+    return GS_INPUT_DOWN;
+  default:
+    return GS_INPUT_NONE;
+  }
+}
+
+// -------- Impaired link --------
+
+struct sim_link {
+  int fd;
+  struct {
+    uint64_t due;
+    uint8_t bytes[LOCKSTEP_PACKET_SIZE];
+  } queue[SIM_QUEUE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t rng;
+};
+
+static void link_send(struct sim_link *link, const struct sim_options *opt,
+                      const struct lockstep_packet *p, struct sim_result *r) {
+  link->rng = mix(link->rng + 1);
+  if (link->rng % 100 < opt->loss || link->head - link->tail >= SIM_QUEUE) {
+    r->dropped++;
+    return;
+  }
+
+  uint32_t slot = link->head++ % SIM_QUEUE;
+  link->queue[slot].due = now_us() + opt->delay_us;
+  lockstep_encode(p, link->queue[slot].bytes);
+  r->sent++;
+}
+
+static void link_flush(struct sim_link *link) {
+  uint64_t now = now_us();
+  while (link->tail != link->head &&
+         link->queue[link->tail % SIM_QUEUE].due <= now) {
+    const uint8_t *bytes = link->queue[link->tail % SIM_QUEUE].bytes;
+    if (send(link->fd, bytes, LOCKSTEP_PACKET_SIZE, MSG_NOSIGNAL) !=
+        LOCKSTEP_PACKET_SIZE) {
+      return; // Peer is gone
+    }
+    link->tail++;
+  }
+}
+
+// -------- Impaired link --------
+
+static struct sim_result sim_side(const struct sim_options *opt, int fd,
+                                  uint32_t nonce) {
+  static struct lockstep ls;
+  static struct game_state gs;
+  static struct sim_link link;
+  struct lockstep_decoder decoder = {0};
+  struct sim_result r = {.nonce = nonce};
+
+  lockstep_init(&ls, nonce);
+  link.fd = fd;
+  link.rng = nonce;
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+
+  uint64_t start = now_us();
+  uint64_t next_tick = start;
+  uint64_t finished_at = 0;
+
+  while (now_us() - start < SIM_TIMEOUT_US) {
+    uint8_t buf[256];
+    ssize_t got;
+    while ((got = read(fd, buf, sizeof(buf))) > 0) {
+      for (ssize_t i = 0; i < got; i++) {
+        struct lockstep_packet p;
+        if (lockstep_decode(&decoder, buf[i], &p)) {
+          lockstep_receive(&ls, &p);
+        }
+      }
+    }
+
+    if (now_us() >= next_tick) {
+      next_tick += opt->period_us;
+
+      if (ls.phase == LOCKSTEP_READY) {
+        sim_setup_state(&gs, 1, lockstep_seed(&ls));
+        lockstep_start(&ls, &gs);
+      }
+      if (ls.phase == LOCKSTEP_RUNNING && ls.ticks < opt->ticks) {
+        lockstep_tick(&ls, &gs, sim_script(ls.side, ls.ticks));
+      }
+      if (ls.phase == LOCKSTEP_DESYNC || ls.phase == LOCKSTEP_LOST) {
+        break;
+      }
+
+      struct lockstep_packet p;
+      lockstep_packet(&ls, &p);
+      link_send(&link, opt, &p, &r);
+
+      // Done once the peer also has every input it needs from us
+      if (!finished_at && ls.phase == LOCKSTEP_RUNNING &&
+          ls.confirmed == opt->ticks && ls.peer_ack >= opt->ticks) {
+        finished_at = now_us();
+      }
+      if (finished_at && now_us() - finished_at > SIM_LINGER_US) {
+        break;
+      }
+    }
+
+    link_flush(&link);
+    usleep(100);
+  }
+
+  r.side = ls.side;
+  r.finished = ls.phase == LOCKSTEP_RUNNING && ls.confirmed == opt->ticks;
+  r.hash = ls.hashes[ls.confirmed & (LOCKSTEP_HISTORY - 1)];
+  r.desync = ls.phase == LOCKSTEP_DESYNC;
+  r.desync_tick = ls.desync_tick;
+  r.lost = ls.phase == LOCKSTEP_LOST;
+  r.rollbacks = ls.rollbacks;
+  r.resimulated = ls.resimulated;
+  r.stalls = ls.stalls;
+  return r;
+}
+
+// Same ticks with every input known from the start
+static uint32_t sim_reference(const struct sim_options *opt, uint32_t seed) {
+  static struct game_state gs;
+  sim_setup_state(&gs, 1, seed);
+
+  for (uint32_t tick = 0; tick < opt->ticks; tick++) {
+    uint8_t input[LOCKSTEP_SIDES] = {GS_INPUT_NONE, GS_INPUT_NONE};
+    if (tick >= LOCKSTEP_INPUT_DELAY) {
+      for (uint side = 0; side < LOCKSTEP_SIDES; side++) {
+        input[side] = sim_script(side, tick - LOCKSTEP_INPUT_DELAY);
+      }
+    }
+    gs_tick_versus(&gs, input[LOCKSTEP_LEFT], input[LOCKSTEP_RIGHT]);
+  }
+  return gs_hash(&gs);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-t ticks] [-d delay ms] [-l loss %%] [-p period us] "
+          "[-s seed]\n",
+          argv0);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  struct sim_options opt = {
+      .ticks = SIM_DEFAULT_TICKS,
+      .delay_us = SIM_DEFAULT_DELAY_MS * 1000,
+      .loss = SIM_DEFAULT_LOSS,
+      .period_us = SIM_DEFAULT_PERIOD_US,
+      .seed = 1,
+  };
+
+  int c;
+  while ((c = getopt(argc, argv, "t:d:l:p:s:")) != -1) {
+    switch (c) {
+    case 't':
+      opt.ticks = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      opt.delay_us = (uint32_t)strtoul(optarg, NULL, 0) * 1000;
+      break;
+    case 'l':
+      opt.loss = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      opt.period_us = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      opt.seed = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (opt.loss >= 100 || opt.period_us == 0) {
+    usage(argv[0]);
+  }
+
+  int link[2];
+  int results[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, link) || pipe(results)) {
+    perror("socketpair");
+    return EXIT_FAILURE;
+  }
+
+  uint32_t nonces[2] = {mix(opt.seed), mix(opt.seed + 0x51ed27u)};
+  for (uint i = 0; i < 2; i++) {
+    if (fork() == 0) {
+      close(link[1 - i]);
+      struct sim_result r = sim_side(&opt, link[i], nonces[i]);
+      if (write(results[1], &r, sizeof(r)) != sizeof(r)) {
+        _exit(EXIT_FAILURE);
+      }
+      _exit(EXIT_SUCCESS);
+    }
+  }
+  close(link[0]);
+  close(link[1]);
+  close(results[1]);
+
+  struct sim_result r[2];
+  for (uint i = 0; i < 2; i++) {
+    if (read(results[0], &r[i], sizeof(r[i])) != sizeof(r[i])) {
+      fprintf(stderr, "a side died\n");
+      return EXIT_FAILURE;
+    }
+  }
+  while (wait(NULL) > 0) {
+  }
+
+  uint32_t reference = sim_reference(&opt, nonces[0] ^ nonces[1]);
+  bool ok = true;
+
+  printf("ticks:        %u, delay %u ms, loss %u%%\n", opt.ticks,
+         opt.delay_us / 1000, opt.loss);
+  for (uint i = 0; i < 2; i++) {
+    printf("%-5s side:   hash 0x%08x, %u rollbacks (%u ticks again), "
+           "%u stalls, %u sent, %u dropped\n",
+           r[i].side == LOCKSTEP_LEFT ? "left" : "right", r[i].hash,
+           r[i].rollbacks, r[i].resimulated, r[i].stalls, r[i].sent,
+           r[i].dropped);
+    if (r[i].desync) {
+      printf("DESYNC at tick %u\n", r[i].desync_tick);
+      ok = false;
+    } else if (r[i].lost) {
+      printf("peer lost\n");
+      ok = false;
+    } else if (!r[i].finished) {
+      printf("did not finish\n");
+      ok = false;
+    } else if (r[i].hash != reference) {
+      ok = false;
+    }
+  }
+  printf("reference:    hash 0x%08x\n", reference);
+  printf("lockstep:     %s\n", ok ? "bit-exact" : "MISMATCH");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,198 @@
+// Headless Pong simulation, the regression benchmark for physics and AI
+// changes. Runs the device game logic with scripted input and reports
+// throughput plus a state hash that must only change when behaviour does.
+//
+// With -w the scripted run is also written as an input recording, with -r a
+// recording (from the device or from -w) is replayed instead of the script.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SIM_HAVE_CYCLE_COUNTER 1
+#else
+#define SIM_HAVE_CYCLE_COUNTER 0
+#endif
+
+#include "game.h"
+#include "replay.h"
+#include "sim_setup.h"
+
+#define SIM_DEFAULT_TICKS 10000000ull
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#if SIM_HAVE_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-t ticks] [-b balls] [-s seed] [-w recording] "
+          "[-r recording]\n",
+          argv0);
+  exit(EXIT_FAILURE);
+}
+
+static uint8_t *read_file(const char *path, uint32_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *data = malloc((size_t)size);
+  if (!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  fclose(f);
+  *len = (uint32_t)size;
+  return data;
+}
+
+static void write_file(const char *path, const uint8_t *data, uint32_t len) {
+  FILE *f = fopen(path, "wb");
+  if (!f || fwrite(data, 1, len, f) != len) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  fclose(f);
+}
+
+int main(int argc, char **argv) {
+  uint64_t ticks = SIM_DEFAULT_TICKS;
+  uint16_t balls = 1;
+  uint32_t seed = 1;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:b:s:w:r:")) != -1) {
+    switch (opt) {
+    case 't':
+      ticks = strtoull(optarg, NULL, 0);
+      break;
+    case 'b':
+      balls = (uint16_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      record_path = optarg;
+      break;
+    case 'r':
+      replay_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  static struct game_state gs;
+  sim_setup_state(&gs, balls, seed);
+
+  struct replay_player player;
+  uint8_t *replay_data = NULL;
+  uint32_t replay_len = 0;
+  if (replay_path) {
+    replay_data = read_file(replay_path, &replay_len);
+    if (!replay_player_begin(&player, replay_data, replay_len, &gs)) {
+      fprintf(stderr, "%s: not a usable recording\n", replay_path);
+      return EXIT_FAILURE;
+    }
+    // Until the recording runs out, each of its bytes holds at most a run
+    ticks = (uint64_t)replay_len * REPLAY_RUN_MAX;
+  }
+
+  struct replay_recorder recorder;
+  uint8_t *record_buf = NULL;
+  if (record_path) {
+    // Worst case one run byte per tick plus the checkpoints
+    uint64_t size = sizeof(struct replay_header) + sizeof(gs) + ticks +
+                    ticks / REPLAY_CHECKPOINT_TICKS * 5 + 16;
+    if (size > UINT32_MAX) {
+      fprintf(stderr, "%llu ticks are too many to record\n",
+              (unsigned long long)ticks);
+      return EXIT_FAILURE;
+    }
+    record_buf = malloc(size);
+    replay_recorder_init(&recorder, record_buf, (uint32_t)size);
+    replay_record_begin(&recorder, &gs);
+  }
+
+  uint64_t rounds = 0;
+  uint64_t start_ns = now_ns();
+  uint64_t start_cycles = now_cycles();
+
+  uint64_t tick;
+  for (tick = 0; tick < ticks; tick++) {
+    uint8_t input;
+    if (!replay_data) {
+      input = sim_scripted_input(&gs, tick);
+    } else if (!replay_player_next(&player, &gs, &input)) {
+      break;
+    }
+
+    gs_tick(&gs, input);
+
+    if (record_buf) {
+      replay_record_tick(&recorder, &gs, input);
+    }
+
+    if (gs.reset_score) {
+      gs.reset_score = false; // Normally cleared by the draw task
+      rounds++;
+    }
+  }
+
+  uint64_t cycles = now_cycles() - start_cycles;
+  uint64_t elapsed_ns = now_ns() - start_ns;
+  double seconds = (double)elapsed_ns / 1e9;
+  ticks = tick;
+
+  if (record_buf) {
+    replay_record_flush(&recorder);
+    write_file(record_path, record_buf, recorder.used);
+  }
+
+  printf("ticks:        %llu\n", (unsigned long long)ticks);
+  printf("balls:        %u\n", gs.entities.count - GAME_ENTITY_BALL);
+  printf("time:         %.3f s\n", seconds);
+  printf("ticks/s:      %.0f\n", (double)ticks / seconds);
+  printf("ns/tick:      %.2f\n", (double)elapsed_ns / (double)ticks);
+#if SIM_HAVE_CYCLE_COUNTER
+  printf("cycles/tick:  %.2f\n", (double)cycles / (double)ticks);
+#else
+  (void)cycles;
+  printf("cycles/tick:  n/a\n");
+#endif
+  printf("rounds:       %llu\n", (unsigned long long)rounds);
+  printf("state hash:   0x%08x\n", gs_hash(&gs));
+  if (replay_data) {
+    printf("replay:       %s\n", !player.desync ? "bit-exact" : "DESYNC");
+    if (player.desync) {
+      printf("desync tick:  %u\n", player.desync_tick);
+    }
+  }
+
+  free(replay_data);
+  free(record_buf);
+  return replay_data && player.desync ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+// Span rasterizer benchmark. Draws each shape at the sizes the games use
+// over and over into a plain canvas and reports pixels/s, next to the
+// per-pixel rectangle loops vga.c used before the rasterizer. A round ball
+// and a dashed net should land close to the filled rectangle.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "raster.h"
+#include "sim_setup.h"
+
+#define BENCH_DEFAULT_ROUNDS 200000u
+
+static uint16_t canvas[SIM_CANVAS_WIDTH * SIM_CANVAS_HEIGHT];
+
+// Kept out of line: on the device every row comes from vga_canvas_row()
+static __attribute__((noinline)) uint16_t *bench_row(uint16_t *base,
+                                                    size_t y) {
+  return &base[y * SIM_CANVAS_WIDTH];
+}
+
+static const struct raster_target target = {
+    .canvas = canvas,
+    .row = bench_row,
+    .width = SIM_CANVAS_WIDTH,
+    .height = SIM_CANVAS_HEIGHT,
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// -------- Shapes --------
+
+// vga_fill_rectangle() as it is, rows fetched the same way the rasterizer
+// does so only the shape code differs
+static void fill_rectangle(size_t x, size_t y, size_t width, size_t height,
+                           uint16_t color) {
+  if (x >= SIM_CANVAS_WIDTH || y >= SIM_CANVAS_HEIGHT)
+    return;
+  if (x + width > SIM_CANVAS_WIDTH)
+    width = SIM_CANVAS_WIDTH - x;
+  if (y + height > SIM_CANVAS_HEIGHT)
+    height = SIM_CANVAS_HEIGHT - y;
+
+  for (size_t row = 0; row < height; row++) {
+    uint16_t *dest = target.row(target.canvas, y + row) + x;
+    for (size_t col = 0; col < width; col++) {
+      dest[col] = color;
+    }
+  }
+}
+
+static void shape_rect(int x, int y, uint16_t color) {
+  fill_rectangle((size_t)x, (size_t)y, 10, 10, color);
+}
+
+static void shape_rect_net(int x, int y, uint16_t color) {
+  (void)y;
+  fill_rectangle((size_t)x, 0, 1, SIM_CANVAS_HEIGHT, color);
+}
+
+// The old vga_draw_rectangle_border(), every pixel checked on its own
+static void shape_border_per_pixel(int x, int y, uint16_t color) {
+  const size_t w = 40;
+  const size_t h = 20;
+  for (size_t col = 0; col < w; col++) {
+    if (x + col < SIM_CANVAS_WIDTH) {
+      if ((size_t)y < SIM_CANVAS_HEIGHT)
+        target.row(canvas, (size_t)y)[x + col] = color;
+      if (y + h - 1 < SIM_CANVAS_HEIGHT)
+        target.row(canvas, y + h - 1)[x + col] = color;
+    }
+  }
+  for (size_t row = 0; row < h; row++) {
+    if (y + row < SIM_CANVAS_HEIGHT) {
+      uint16_t *dest = target.row(canvas, y + row);
+      if ((size_t)x < SIM_CANVAS_WIDTH)
+        dest[x] = color;
+      if (x + w - 1 < SIM_CANVAS_WIDTH)
+        dest[x + w - 1] = color;
+    }
+  }
+}
+
+static void shape_border(int x, int y, uint16_t color) {
+  raster_rect_border(&target, x, y, 40, 20, color);
+}
+
+static void shape_ball(int x, int y, uint16_t color) {
+  raster_fill_round_rect(&target, x, y, 10, 10, 5, color);
+}
+
+static void shape_ball_move(int x, int y, uint16_t color) {
+  raster_move_round_rect(&target, x - 2, y - 3, x, y, 10, 10, 5, color);
+}
+
+static void shape_circle(int x, int y, uint16_t color) {
+  raster_fill_circle(&target, x + 10, y + 10, 10, color);
+}
+
+static void shape_round_rect(int x, int y, uint16_t color) {
+  raster_fill_round_rect(&target, x, y, 40, 20, 6, color);
+}
+
+static void shape_line(int x, int y, uint16_t color) {
+  raster_line(&target, x, y, x + 60, y + 25, color);
+}
+
+static void shape_steep_line(int x, int y, uint16_t color) {
+  raster_line(&target, x, y, x + 7, y + 40, color);
+}
+
+static void shape_net(int x, int y, uint16_t color) {
+  (void)y;
+  raster_dashed_vline(&target, x, 0, 2, SIM_CANVAS_HEIGHT, 6, 4, color);
+}
+
+// -------- Shapes --------
+
+struct bench_shape {
+  const char *name;
+  void (*draw)(int x, int y, uint16_t color);
+};
+
+static const struct bench_shape shapes[] = {
+    {"rect 10x10", shape_rect},
+    {"ball 10x10", shape_ball},
+    {"ball move", shape_ball_move},
+    {"circle r10", shape_circle},
+    {"round rect", shape_round_rect},
+    {"border old", shape_border_per_pixel},
+    {"border", shape_border},
+    {"line flat", shape_line},
+    {"line steep", shape_steep_line},
+    {"solid line", shape_rect_net},
+    {"net", shape_net},
+};
+
+// Pixels one draw of the shape sets, counted on a blank canvas
+static uint32_t shape_pixels(const struct bench_shape *shape) {
+  memset(canvas, 0, sizeof(canvas));
+  shape->draw(100, 100, 0xffff);
+
+  uint32_t pixels = 0;
+  for (size_t i = 0; i < SIM_CANVAS_WIDTH * SIM_CANVAS_HEIGHT; i++) {
+    pixels += canvas[i] != 0;
+  }
+  return pixels;
+}
+
+int main(int argc, char **argv) {
+  uint32_t rounds = BENCH_DEFAULT_ROUNDS;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      rounds = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n rounds]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%-12s %8s %10s %10s\n", "shape", "pixels", "ns/shape", "Mpixels/s");
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+    const struct bench_shape *shape = &shapes[s];
+    uint32_t pixels = shape_pixels(shape);
+
+    // Walk the shape over the court so rows and alignment vary
+    uint64_t start_ns = now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+      int x = 4 + (int)(i * 7 % 220);
+      int y = 4 + (int)(i * 13 % 170);
+      shape->draw(x, y, (uint16_t)i);
+    }
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    double ns_per_shape = (double)elapsed_ns / (double)rounds;
+    printf("%-12s %8u %10.1f %10.1f\n", shape->name, pixels, ns_per_shape,
+           (double)pixels * 1e3 / ns_per_shape);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "sim_setup.h"
+
+void sim_setup_state(struct game_state *gs, uint16_t balls, uint32_t seed) {
+  struct pong_rect ball = {
+      .x = 20,
+      .y = 20,
+      .w = 10,
+      .h = 10,
+      .v_x = 2,
+      .v_y = 2,
+  };
+
+  struct pong_rect player = {
+      .x = 20,
+      .x_old = 20,
+      .y = 100,
+      .y_old = 100,
+      .w = 5,
+      .h = 50,
+      .v_x = 20,
+      .v_y = 5,
+  };
+
+  struct pong_rect AI = {
+      .x = SIM_CANVAS_WIDTH - 25,
+      .x_old = SIM_CANVAS_WIDTH - 25,
+      .y = 100,
+      .y_old = 100,
+      .w = 5,
+      .h = 50,
+      .v_x = 2,
+      .v_y = 2,
+  };
+
+  memset(gs, 0, sizeof(*gs));
+  gs->padding_x = 4;
+  gs->padding_y = 10;
+  gs->canvas_w = SIM_CANVAS_WIDTH;
+  gs->canvas_h = SIM_CANVAS_HEIGHT;
+
+  gs_add_entity(gs, &player);
+  gs_add_entity(gs, &AI);
+  gs_add_entity(gs, &ball);
+  gs_set_ball_count(gs, balls);
+
+  ai_init(&gs->ai, AI_DIFFICULTY_NORMAL, seed);
+}
+
+uint8_t sim_scripted_input(const struct game_state *gs, uint64_t tick) {
+  const struct entity_store *es = &gs->entities;
+
+  // A sloppy human: only looks at the first ball every few ticks, and
+  // sometimes presses the wrong way
+  if (tick % 3) {
+    return GS_INPUT_NONE;
+  }
+  if ((tick / 3) % 17 == 0) {
+    return (tick & 8) ? GS_INPUT_DOWN : GS_INPUT_UP;
+  }
+
+  int centre = es->y[GAME_ENTITY_PLAYER] + es->h[GAME_ENTITY_PLAYER] / 2;
+  int ball = es->y[GAME_ENTITY_BALL] + es->h[GAME_ENTITY_BALL] / 2;
+  if (ball < centre - 4) {
+    return GS_INPUT_UP;
+  } else if (ball > centre + 4) {
+    return GS_INPUT_DOWN;
+  }
+  return GS_INPUT_NONE;
+}
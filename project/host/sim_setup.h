@@ -0,0 +1,15 @@
+#ifndef _SIM_SETUP_H_
+#define _SIM_SETUP_H_
+
+#include "game.h"
+
+#define SIM_CANVAS_WIDTH 320
+#define SIM_CANVAS_HEIGHT 240
+
+// Same court, paddles and ball as main() builds on the device
+void sim_setup_state(struct game_state *gs, uint16_t balls, uint32_t seed);
+
+// Scripted GS_INPUT_* for tick `tick`
+uint8_t sim_scripted_input(const struct game_state *gs, uint64_t tick);
+
+#endif
@@ -0,0 +1,113 @@
+// Sprite decode benchmark. Draws every sprite tools/png2sprite.py generated
+// from assets/ over and over into a plain canvas and reports opaque pixels/s
+// next to copying the same box as raw pixels. Runs after every host build, so
+// the decode cost of new art shows up in the build log.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "assets.h"
+#include "sim_setup.h"
+#include "sprite.h"
+
+#define BENCH_DEFAULT_ROUNDS 200000u
+
+static uint16_t canvas[SIM_CANVAS_WIDTH * SIM_CANVAS_HEIGHT];
+static uint16_t pixels[SIM_CANVAS_WIDTH * SIM_CANVAS_HEIGHT];
+
+// Kept out of line: on the device every row comes from vga_canvas_row()
+static __attribute__((noinline)) uint16_t *bench_row(uint16_t *base,
+                                                    size_t y) {
+  return &base[y * SIM_CANVAS_WIDTH];
+}
+
+static const struct raster_target target = {
+    .canvas = canvas,
+    .row = bench_row,
+    .width = SIM_CANVAS_WIDTH,
+    .height = SIM_CANVAS_HEIGHT,
+};
+
+#define BENCH_SPRITE(sprite) &sprite,
+static const struct sprite *const sprites[] = {ASSET_SPRITES(BENCH_SPRITE)};
+static const char *const names[] = {
+#define BENCH_NAME(sprite) #sprite,
+    ASSET_SPRITES(BENCH_NAME)};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Opaque pixels and spans, straight from the span data
+static void sprite_count(const struct sprite *sprite, uint32_t *opaque,
+                         uint32_t *spans) {
+  const uint8_t *at = sprite->spans;
+  *opaque = 0;
+  *spans = 0;
+  for (uint row = 0; row < sprite->height; row++) {
+    uint count = *at++;
+    for (uint i = 0; i < count; i++, at += 3) {
+      *opaque += at[1];
+    }
+    *spans += count;
+  }
+}
+
+// What an uncompressed sprite would cost: one row copy per sprite row
+static void raw_copy(const struct sprite *sprite, int x, int y) {
+  for (int row = 0; row < sprite->height; row++) {
+    memcpy(target.row(canvas, (size_t)(y + row)) + x,
+           &pixels[row * sprite->width], sprite->width * sizeof(uint16_t));
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t rounds = BENCH_DEFAULT_ROUNDS;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      rounds = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n rounds]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%-16s %8s %6s %10s %10s %10s\n", "sprite", "opaque", "spans",
+         "ns/sprite", "Mpixels/s", "ns raw");
+  for (size_t s = 0; s < sizeof(sprites) / sizeof(sprites[0]); s++) {
+    const struct sprite *sprite = sprites[s];
+    uint32_t opaque;
+    uint32_t spans;
+    sprite_count(sprite, &opaque, &spans);
+
+    // Walk the sprite over the court so rows and alignment vary
+    int range_x = SIM_CANVAS_WIDTH - sprite->width;
+    int range_y = SIM_CANVAS_HEIGHT - sprite->height;
+    uint64_t start_ns = now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+      sprite_draw(&target, sprite, (int)(i * 7 % (uint32_t)(range_x + 1)),
+                  (int)(i * 13 % (uint32_t)(range_y + 1)));
+    }
+    double ns_sprite = (double)(now_ns() - start_ns) / (double)rounds;
+
+    start_ns = now_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+      raw_copy(sprite, (int)(i * 7 % (uint32_t)(range_x + 1)),
+               (int)(i * 13 % (uint32_t)(range_y + 1)));
+    }
+    double ns_raw = (double)(now_ns() - start_ns) / (double)rounds;
+
+    printf("%-16s %8u %6u %10.1f %10.1f %10.1f\n", names[s], opaque, spans,
+           ns_sprite, (double)opaque * 1e3 / ns_sprite, ns_raw);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#include "ai.h"
+#include "game.h"
+
+#define AI_NO_BALL UINT16_MAX
+
+static uint32_t ai_next_random(struct ai_state *ai) {
+  // xorshift32, cheap and identical on every platform
+  uint32_t x = ai->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  ai->rng = x;
+  return x;
+}
+
+// Ticks until the ball reaches the AI paddle face, negative if never
+static int32_t ai_ticks_to_paddle(const struct entity_store *es,
+                                  uint16_t ball) {
+  int32_t v_x = es->v_x[ball];
+  int32_t face = es->x[GAME_ENTITY_AI] - es->w[ball];
+  int32_t distance = face - es->x[ball];
+
+  if (v_x <= 0 || distance < 0) {
+    return -1;
+  }
+  return (distance + v_x - 1) / v_x;
+}
+
+// The incoming ball that arrives first. The order only changes when some ball
+// changes velocity, so this runs on events and not every tick.
+static uint16_t ai_pick_ball(const struct game_state *gs) {
+  const struct entity_store *es = &gs->entities;
+
+  uint16_t best = AI_NO_BALL;
+  int32_t best_ticks = INT32_MAX;
+  for (uint16_t i = GAME_ENTITY_BALL; i < es->count; i++) {
+    int32_t ticks = ai_ticks_to_paddle(es, i);
+    if (ticks >= 0 && ticks < best_ticks) {
+      best = i;
+      best_ticks = ticks;
+    }
+  }
+  return best;
+}
+
+void ai_init(struct ai_state *ai, struct ai_difficulty difficulty,
+             uint32_t seed) {
+  ai->difficulty = difficulty;
+  ai->target_y = 0;
+  ai->aim_error = 0;
+  ai->delay = 0;
+  ai->needs_solve = true;
+  ai->rng = seed ? seed : 0x2545f491u; // xorshift must not start at zero
+}
+
+void ai_set_difficulty(struct ai_state *ai, struct ai_difficulty difficulty) {
+  ai->difficulty = difficulty;
+  ai->needs_solve = true;
+}
+
+uint16_t ai_predict_intercept(const struct game_state *gs, uint16_t ball) {
+  const struct entity_store *es = &gs->entities;
+
+  int32_t top = gs->padding_y;
+  int32_t span = gs->canvas_h - gs->padding_y - es->h[ball] - top;
+  int32_t ticks = ai_ticks_to_paddle(es, ball);
+
+  if (ticks < 0 || span <= 0) {
+    return es->y[ball];
+  }
+
+  // Unfold the walls: the ball travels in a straight line through mirrored
+  // copies of the court, so fold the straight-line distance back into it.
+  int32_t period = 2 * span;
+  int32_t travel = (es->y[ball] - top) + es->v_y[ball] * ticks;
+
+  travel %= period;
+  if (travel < 0) {
+    travel += period;
+  }
+  if (travel > span) {
+    travel = period - travel;
+  }
+
+  return (uint16_t)(top + travel);
+}
+
+int ai_update(struct game_state *gs) {
+  struct ai_state *ai = &gs->ai;
+  const struct entity_store *es = &gs->entities;
+
+  if (ai->needs_solve || gs->events) {
+    // A paddle hit, a score or a reset starts a new volley: wait the reaction
+    // time and aim somewhere new. Wall bounces only refine the solution.
+    if (ai->needs_solve ||
+        (gs->events & (GS_EVENT_PADDLE | GS_EVENT_SCORE | GS_EVENT_RESET))) {
+      int32_t range = 2 * ai->difficulty.error_px + 1;
+      ai->aim_error = (int16_t)((int32_t)(ai_next_random(ai) % range) -
+                                ai->difficulty.error_px);
+      ai->delay = ai->difficulty.reaction_ticks;
+    }
+
+    uint16_t ball = ai_pick_ball(gs);
+    if (ball == AI_NO_BALL) {
+      ai->target_y = gs->canvas_h / 2; // Nothing incoming: return home
+    } else {
+      ai->target_y = ai_predict_intercept(gs, ball) + es->h[ball] / 2 +
+                     ai->aim_error;
+    }
+
+    ai->needs_solve = false;
+  }
+
+  if (ai->delay) {
+    ai->delay--;
+    return 0;
+  }
+
+  // Stop within one step of the target, so the paddle never oscillates
+  int32_t centre = es->y[GAME_ENTITY_AI] + es->h[GAME_ENTITY_AI] / 2;
+  int32_t dead_zone = es->v_y[GAME_ENTITY_AI];
+  int32_t target = (int16_t)ai->target_y;
+
+  if (centre + dead_zone < target) {
+    return 1; // Move paddle down
+  } else if (centre - dead_zone > target) {
+    return -1; // Move paddle up
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _AI_H_
+#define _AI_H_
+
+#include <pico.h>
+
+struct game_state;
+
+struct ai_difficulty {
+  uint8_t reaction_ticks; // Ticks before the paddle reacts to a new volley
+  uint8_t error_px;       // Maximum aiming error, re-rolled every volley
+};
+
+// -------- Difficulty --------
+
+#define AI_DIFFICULTY_EASY                                                     \
+  ((struct ai_difficulty){.reaction_ticks = 12, .error_px = 30})
+#define AI_DIFFICULTY_NORMAL                                                   \
+  ((struct ai_difficulty){.reaction_ticks = 6, .error_px = 14})
+#define AI_DIFFICULTY_HARD                                                     \
+  ((struct ai_difficulty){.reaction_ticks = 1, .error_px = 4})
+
+// -------- Difficulty --------
+
+struct ai_state {
+  struct ai_difficulty difficulty;
+
+  uint16_t target_y; // Where the paddle centre should end up
+  int16_t aim_error; // Offset applied to target_y for the current volley
+  uint8_t delay;     // Ticks left before the paddle starts moving
+
+  bool needs_solve; // Set until the first trajectory has been solved
+  uint32_t rng;     // Deterministic so replays and lockstep stay in sync
+};
+
+void ai_init(struct ai_state *ai, struct ai_difficulty difficulty,
+             uint32_t seed);
+void ai_set_difficulty(struct ai_state *ai, struct ai_difficulty difficulty);
+
+// Y coordinate at which the ball will reach the AI paddle, walls included
+uint16_t ai_predict_intercept(const struct game_state *gs, uint16_t ball);
+
+// Returns the paddle direction for this tick (-1, 0 or 1)
+int ai_update(struct game_state *gs);
+
+#endif
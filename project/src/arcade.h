@@ -0,0 +1,32 @@
+#ifndef _ARCADE_H_
+#define _ARCADE_H_
+
+#include <pico.h>
+
+#include "draw.h"
+
+// A game hosted by the VGA, IR and task setup in main.c. The logic task calls
+// input(), update() and draw() every 33 ms tick with the game state mutex
+// held, so the hooks never lock it themselves. Games never touch the canvas,
+// the draw task replays what draw() recorded.
+struct arcade_game {
+  const char *name;
+
+  // (Re)starts the game, the canvas has just been cleared
+  void (*init)(void);
+
+  // Maps the IR command received since the last tick to a per-tick input
+  uint8_t (*input)(uint8_t ir_command);
+
+  // Advances the game by one tick
+  void (*update)(uint8_t input);
+
+  // Records what changed this tick. When list->lost is set, earlier commands
+  // were dropped and everything has to be recorded again.
+  void (*draw)(struct draw_list *list);
+};
+
+extern const struct arcade_game pong_game;
+extern const struct arcade_game breakout_game;
+
+#endif
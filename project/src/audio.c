@@ -0,0 +1,239 @@
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include <hardware/pwm.h>
+
+#include "audio.h"
+#include "stats.h"
+
+#define AUDIO_WAVE_LEN 256 // Samples per wavetable period, indexed by phase
+
+// Phase step of a frequency, the table index is the top 8 bits of the phase
+#define AUDIO_STEP(hz)                                                         \
+  ((int32_t)(((int64_t)(hz) << 32) / AUDIO_SAMPLE_RATE))
+#define AUDIO_BLOCKS(ms) ((ms) * AUDIO_SAMPLE_RATE / 1000 / AUDIO_BLOCK)
+
+enum audio_wave {
+  AUDIO_SQUARE,
+  AUDIO_TRIANGLE,
+  AUDIO_NOISE,
+  AUDIO_WAVE_COUNT,
+};
+
+struct audio_sound {
+  uint8_t wave;   // enum audio_wave
+  uint8_t volume; // Peak level, 255 is a quarter of the output range
+  uint8_t decay;  // Volume lost per block
+  uint8_t blocks; // Length
+  int32_t step;   // AUDIO_STEP() of the start frequency
+  int32_t sweep;  // Added to the step every block
+};
+
+// Read by the interrupt, so kept out of flash
+static const struct audio_sound __not_in_flash("audio")
+    sounds[AUDIO_EFFECT_COUNT] = {
+        [AUDIO_PADDLE] = {AUDIO_SQUARE, 160, 12, AUDIO_BLOCKS(80),
+                          AUDIO_STEP(880), 0},
+        [AUDIO_WALL] = {AUDIO_SQUARE, 120, 12, AUDIO_BLOCKS(60),
+                        AUDIO_STEP(440), 0},
+        [AUDIO_BRICK] = {AUDIO_TRIANGLE, 255, 16, AUDIO_BLOCKS(120),
+                         AUDIO_STEP(1320), AUDIO_STEP(40)},
+        [AUDIO_SCORE] = {AUDIO_NOISE, 200, 6, AUDIO_BLOCKS(400),
+                         AUDIO_STEP(160), -AUDIO_STEP(2)},
+};
+
+struct audio_voice {
+  const int8_t *wave;
+  uint32_t phase;
+  int32_t step;
+  int32_t sweep;
+  uint8_t volume;
+  uint8_t decay;
+  uint8_t blocks; // Left to play, 0 when the voice is free
+};
+
+static int8_t waves[AUDIO_WAVE_COUNT][AUDIO_WAVE_LEN];
+static struct audio_voice voices[AUDIO_VOICES];
+
+// Played in turn by the two DMA channels
+static uint16_t blocks[2][AUDIO_BLOCK];
+static int32_t mix[AUDIO_BLOCK];
+static uint dma_channels[2];
+
+// Filled by audio_play(), drained by the block interrupt
+static uint8_t queue[AUDIO_QUEUE];
+static volatile uint32_t queue_head;
+static volatile uint32_t queue_tail;
+
+static void audio_make_waves(void) {
+  uint32_t lfsr = 0xACE1u;
+  for (uint i = 0; i < AUDIO_WAVE_LEN; i++) {
+    waves[AUDIO_SQUARE][i] = i < AUDIO_WAVE_LEN / 2 ? 127 : -127;
+
+    // Up from -128 over the first half, back down over the second
+    uint up = i < AUDIO_WAVE_LEN / 2 ? i : AUDIO_WAVE_LEN - 1 - i;
+    waves[AUDIO_TRIANGLE][i] = (int8_t)(up * 2 - 128 + (up * 2 >= 128));
+
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    waves[AUDIO_NOISE][i] = (int8_t)lfsr;
+  }
+}
+
+static void __not_in_flash_func(audio_start_voice)(uint8_t effect) {
+  const struct audio_sound *sound = &sounds[effect];
+
+  // A free voice, or the one nearest to its end
+  struct audio_voice *voice = &voices[0];
+  for (uint i = 1; i < AUDIO_VOICES && voice->blocks; i++) {
+    if (voices[i].blocks < voice->blocks) {
+      voice = &voices[i];
+    }
+  }
+
+  voice->wave = waves[sound->wave];
+  voice->phase = 0;
+  voice->step = sound->step;
+  voice->sweep = sound->sweep;
+  voice->volume = sound->volume;
+  voice->decay = sound->decay;
+  voice->blocks = sound->blocks;
+}
+
+// Fills `out` with the next block. Each voice holds its pitch and volume for
+// the whole block, so the inner loop is a load, a multiply and an add.
+static void __not_in_flash_func(audio_mix)(uint16_t *out) {
+  uint32_t tail = queue_tail;
+  uint32_t head = __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+  for (; tail != head; tail++) {
+    audio_start_voice(queue[tail & (AUDIO_QUEUE - 1)]);
+  }
+  __atomic_store_n(&queue_tail, tail, __ATOMIC_RELEASE);
+
+  for (uint i = 0; i < AUDIO_BLOCK; i++) {
+    mix[i] = 0;
+  }
+
+  for (uint v = 0; v < AUDIO_VOICES; v++) {
+    struct audio_voice *voice = &voices[v];
+    if (!voice->blocks) {
+      continue;
+    }
+
+    const int8_t *wave = voice->wave;
+    uint32_t phase = voice->phase;
+    uint32_t step = (uint32_t)voice->step;
+    int32_t volume = voice->volume;
+    for (uint i = 0; i < AUDIO_BLOCK; i++) {
+      mix[i] += wave[phase >> 24] * volume;
+      phase += step;
+    }
+
+    voice->phase = phase;
+    voice->step += voice->sweep;
+    voice->volume = voice->volume > voice->decay
+                        ? (uint8_t)(voice->volume - voice->decay)
+                        : 0;
+    voice->blocks = voice->volume ? (uint8_t)(voice->blocks - 1) : 0;
+  }
+
+  // A voice peaks at 127 * 255, so four of them just fit the 10-bit range
+  for (uint i = 0; i < AUDIO_BLOCK; i++) {
+    int32_t level = (AUDIO_PWM_WRAP + 1) / 2 + (mix[i] >> 8);
+    out[i] = (uint16_t)(level < 0                ? 0
+                        : level > AUDIO_PWM_WRAP ? AUDIO_PWM_WRAP
+                                                 : level);
+  }
+}
+
+static void __not_in_flash_func(audio_dma_irq)(void) {
+  uint32_t entered_at = stats_isr_enter(STATS_ISR_AUDIO);
+
+  for (uint i = 0; i < 2; i++) {
+    uint channel = dma_channels[i];
+    if (dma_irqn_get_channel_status(1, channel)) {
+      dma_irqn_acknowledge_channel(1, channel);
+      // The other channel is playing now. Rewind this one without starting
+      // it, the chain starts it once the other block is done.
+      dma_channel_set_read_addr(channel, blocks[i], false);
+      audio_mix(blocks[i]);
+    }
+  }
+
+  stats_isr_exit(STATS_ISR_AUDIO, entered_at);
+}
+
+// The DMA timer runs at sys_clk * x / y with both 16 bits wide, look for the
+// pair closest to the sample rate
+static void audio_set_timer(uint timer) {
+  uint32_t sys_hz = clock_get_hz(clk_sys);
+  uint32_t best_x = 1;
+  uint32_t best_y = 0xFFFF;
+  uint32_t best_error = UINT32_MAX;
+
+  for (uint32_t x = 1; x <= 0xFFFF; x++) {
+    uint64_t y = ((uint64_t)sys_hz * x + AUDIO_SAMPLE_RATE / 2) /
+                 AUDIO_SAMPLE_RATE;
+    if (y > 0xFFFF) {
+      break;
+    }
+    uint32_t rate = (uint32_t)((uint64_t)sys_hz * x / y);
+    uint32_t error = rate > AUDIO_SAMPLE_RATE ? rate - AUDIO_SAMPLE_RATE
+                                              : AUDIO_SAMPLE_RATE - rate;
+    if (error < best_error) {
+      best_x = x;
+      best_y = (uint32_t)y;
+      best_error = error;
+    }
+  }
+
+  dma_timer_set_fraction(timer, (uint16_t)best_x, (uint16_t)best_y);
+}
+
+void audio_init(void) {
+  audio_make_waves();
+  for (uint i = 0; i < AUDIO_BLOCK; i++) {
+    blocks[0][i] = blocks[1][i] = (AUDIO_PWM_WRAP + 1) / 2;
+  }
+
+  gpio_set_function(AUDIO_PIN, GPIO_FUNC_PWM);
+  uint slice = pwm_gpio_to_slice_num(AUDIO_PIN);
+  pwm_config pwm = pwm_get_default_config();
+  pwm_config_set_wrap(&pwm, AUDIO_PWM_WRAP);
+  pwm_init(slice, &pwm, true);
+
+  uint timer = (uint)dma_claim_unused_timer(true);
+  audio_set_timer(timer);
+
+  dma_channels[0] = (uint)dma_claim_unused_channel(true);
+  dma_channels[1] = (uint)dma_claim_unused_channel(true);
+  for (uint i = 0; i < 2; i++) {
+    dma_channel_config c = dma_channel_get_default_config(dma_channels[i]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+    channel_config_set_chain_to(&c, dma_channels[i ^ 1]);
+    // A halfword write lands in both halves of CC, channel B is unused
+    dma_channel_configure(dma_channels[i], &c,
+                          &pwm_hw->slice[slice].cc, blocks[i], AUDIO_BLOCK,
+                          false);
+    dma_irqn_set_channel_enabled(1, dma_channels[i], true);
+  }
+
+  // Scanvideo has DMA_IRQ_0
+  irq_set_exclusive_handler(DMA_IRQ_1, audio_dma_irq);
+  irq_set_enabled(DMA_IRQ_1, true);
+  dma_channel_start(dma_channels[0]);
+}
+
+bool audio_play(enum audio_effect effect) {
+  uint32_t head = queue_head;
+  if (head - __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE) >= AUDIO_QUEUE) {
+    return false;
+  }
+
+  queue[head & (AUDIO_QUEUE - 1)] = (uint8_t)effect;
+  __atomic_store_n(&queue_head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
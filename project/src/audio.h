@@ -0,0 +1,40 @@
+#ifndef _AUDIO_H_
+#define _AUDIO_H_
+
+#include <pico.h>
+
+// Sound effects on a PWM pin. Two chained DMA channels play a pair of sample
+// blocks in turn, paced by a DMA timer at AUDIO_SAMPLE_RATE. The interrupt at
+// the end of each block mixes the next one while the other plays, so the CPU
+// only wakes up every AUDIO_BLOCK samples. The cost shows up as the "audio"
+// ISR record in the stats.
+//
+// Every voice loops a one-period wavetable (square, triangle or noise) at a
+// fixed point phase step, with a pitch sweep and a volume decay applied once
+// per block.
+
+#define AUDIO_PIN 28        // PWM6 A, through an RC low-pass into an amplifier
+#define AUDIO_SAMPLE_RATE 22050
+#define AUDIO_BLOCK 256     // Samples per DMA block, about 11.6 ms
+#define AUDIO_VOICES 4      // Mixed at once, the nearest to its end gives way
+#define AUDIO_QUEUE 8       // Effects waiting for a block, a power of two
+#define AUDIO_PWM_WRAP 1023 // 10-bit samples, the carrier is far above audio
+
+enum audio_effect {
+  AUDIO_PADDLE, // A ball bounced off a paddle
+  AUDIO_WALL,   // A ball bounced off a wall
+  AUDIO_BRICK,  // Breakout brick destroyed
+  AUDIO_SCORE,  // Point scored or ball lost
+  AUDIO_EFFECT_COUNT,
+};
+
+// Claims two DMA channels, a DMA timer and the PWM slice of AUDIO_PIN and
+// starts playing silence. The block interrupt runs on the calling core.
+void audio_init(void);
+
+// Queues an effect for the next block. Never blocks: returns false when the
+// queue is full and the effect is dropped. Only one task may call it, the
+// logic task.
+bool audio_play(enum audio_effect effect);
+
+#endif
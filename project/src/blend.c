@@ -0,0 +1,85 @@
+#include "blend.h"
+
+// Canvas rows are word aligned, spans are read and written a word at a time
+typedef uint32_t __attribute__((may_alias)) blend_word;
+
+// Next two source pixels as one word, whatever the source alignment
+static inline uint32_t blend_load2(const uint16_t *src) {
+  return (uint32_t)src[0] | (uint32_t)src[1] << 16;
+}
+
+void __not_in_flash_func(blend_alpha_span)(uint16_t *dest,
+                                           const uint16_t *src, uint count,
+                                           uint alpha) {
+  alpha = MIN(alpha, BLEND_ALPHA_MAX);
+
+  // A leading odd pixel goes through the kernel alone
+  if (count && ((uintptr_t)dest & 2)) {
+    dest[0] = (uint16_t)blend_alpha2(src[0], dest[0], alpha);
+    dest++;
+    src++;
+    count--;
+  }
+
+  blend_word *words = (blend_word *)dest;
+  for (uint i = 0; i < count / 2; i++) {
+    words[i] = blend_alpha2(blend_load2(&src[2 * i]), words[i], alpha);
+  }
+
+  if (count & 1) {
+    dest[count - 1] =
+        (uint16_t)blend_alpha2(src[count - 1], dest[count - 1], alpha);
+  }
+}
+
+void __not_in_flash_func(blend_add_span)(uint16_t *dest, const uint16_t *src,
+                                         uint count) {
+  if (count && ((uintptr_t)dest & 2)) {
+    dest[0] = (uint16_t)blend_add2(src[0], dest[0]);
+    dest++;
+    src++;
+    count--;
+  }
+
+  blend_word *words = (blend_word *)dest;
+  for (uint i = 0; i < count / 2; i++) {
+    words[i] = blend_add2(blend_load2(&src[2 * i]), words[i]);
+  }
+
+  if (count & 1) {
+    dest[count - 1] = (uint16_t)blend_add2(src[count - 1], dest[count - 1]);
+  }
+}
+
+void __not_in_flash_func(blend_fade_span)(uint16_t *dest, uint count,
+                                          uint16_t color, uint alpha) {
+  alpha = MIN(alpha, BLEND_ALPHA_MAX);
+  uint32_t inv = BLEND_ALPHA_MAX - alpha;
+
+  // The target colour's share is the same for every pixel, so only the
+  // destination is multiplied inside the loop
+  uint32_t pair = (uint32_t)color | (uint32_t)color << 16;
+  uint32_t r = (pair & BLEND_LANE) * alpha;
+  uint32_t g = ((pair >> BLEND_G_SHIFT) & BLEND_LANE) * alpha;
+  uint32_t b = ((pair >> BLEND_B_SHIFT) & BLEND_LANE) * alpha;
+
+  if (count && ((uintptr_t)dest & 2)) {
+    dest[0] = (uint16_t)blend_alpha2(color, dest[0], alpha);
+    dest++;
+    count--;
+  }
+
+  blend_word *words = (blend_word *)dest;
+  for (uint i = 0; i < count / 2; i++) {
+    uint32_t word = words[i];
+    uint32_t fr = ((word & BLEND_LANE) * inv + r) >> 5;
+    uint32_t fg = (((word >> BLEND_G_SHIFT) & BLEND_LANE) * inv + g) >> 5;
+    uint32_t fb = (((word >> BLEND_B_SHIFT) & BLEND_LANE) * inv + b) >> 5;
+    words[i] = (fr & BLEND_LANE) | (fg & BLEND_LANE) << BLEND_G_SHIFT |
+               (fb & BLEND_LANE) << BLEND_B_SHIFT;
+  }
+
+  if (count & 1) {
+    dest[count - 1] = (uint16_t)blend_alpha2(color, dest[count - 1], alpha);
+  }
+}
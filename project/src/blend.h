@@ -0,0 +1,81 @@
+#ifndef _BLEND_H_
+#define _BLEND_H_
+
+#include <pico.h>
+
+// Translucent drawing on the packed RGB555 canvas. Two pixels are handled
+// per 32-bit word with the channels masked apart so that they can be
+// multiplied or added without spilling into each other. Nothing here knows
+// about scanvideo, the host benchmark runs the same code.
+
+// Channel layout of PICO_SCANVIDEO_PIXEL_FROM_RGB5(), checked in vga.c
+#define BLEND_R_SHIFT 0
+#define BLEND_G_SHIFT 6
+#define BLEND_B_SHIFT 11
+
+#define BLEND_ALPHA_MAX 32 // Alpha runs from 0 (keep dest) to this (source)
+
+// -------- Two-pixel kernels --------
+
+// One channel of both pixels at bits 0-4 and 16-20. A 5-bit value times an
+// alpha of up to 32 still fits below the next pixel.
+#define BLEND_LANE 0x001f001fu
+
+// Red and green of both pixels, with the unused bit 5 and bit 11 as guards
+#define BLEND_RG 0x07df07dfu
+#define BLEND_RG_GUARD 0x08200820u
+
+// Blue of both pixels moved down a bit, guarded by bits 15 and 31
+#define BLEND_B 0x7c007c00u
+#define BLEND_B_GUARD 0x80008000u
+
+// src * alpha + dst * (32 - alpha), per channel
+static inline uint32_t blend_alpha2(uint32_t src, uint32_t dst,
+                                    uint32_t alpha) {
+  uint32_t inv = BLEND_ALPHA_MAX - alpha;
+
+  uint32_t r = ((src & BLEND_LANE) * alpha + (dst & BLEND_LANE) * inv) >> 5;
+  uint32_t g = (((src >> BLEND_G_SHIFT) & BLEND_LANE) * alpha +
+                ((dst >> BLEND_G_SHIFT) & BLEND_LANE) * inv) >>
+               5;
+  uint32_t b = (((src >> BLEND_B_SHIFT) & BLEND_LANE) * alpha +
+                ((dst >> BLEND_B_SHIFT) & BLEND_LANE) * inv) >>
+               5;
+
+  return (r & BLEND_LANE) | (g & BLEND_LANE) << BLEND_G_SHIFT |
+         (b & BLEND_LANE) << BLEND_B_SHIFT;
+}
+
+// Per channel sum, clamped at full intensity. A channel that carried into its
+// guard bit is filled with ones instead.
+static inline uint32_t blend_add2(uint32_t src, uint32_t dst) {
+  uint32_t rg = (src & BLEND_RG) + (dst & BLEND_RG);
+  uint32_t carry = rg & BLEND_RG_GUARD;
+  rg = (rg | (carry - (carry >> 5))) & BLEND_RG;
+
+  uint32_t b = ((src >> 1) & BLEND_B) + ((dst >> 1) & BLEND_B);
+  carry = b & BLEND_B_GUARD;
+  b = (b | (carry - (carry >> 5))) & BLEND_B;
+
+  return rg | b << 1;
+}
+
+// -------- Two-pixel kernels --------
+
+// -------- Spans --------
+
+// dest = src blended over dest with alpha out of BLEND_ALPHA_MAX
+void blend_alpha_span(uint16_t *dest, const uint16_t *src, uint count,
+                      uint alpha);
+
+// dest = dest + src, saturating, for glows and flashes
+void blend_add_span(uint16_t *dest, const uint16_t *src, uint count);
+
+// Moves every pixel alpha / BLEND_ALPHA_MAX of the way toward color. Fading
+// toward the background a little every frame leaves a trail behind anything
+// that moves.
+void blend_fade_span(uint16_t *dest, uint count, uint16_t color, uint alpha);
+
+// -------- Spans --------
+
+#endif
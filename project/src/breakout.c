@@ -0,0 +1,390 @@
+// Breakout, the second game hosted by the arcade framework. The bricks sit on
+// a uniform grid, so the ball only ever tests the handful of cells under it,
+// and only bricks destroyed since the last frame are redrawn.
+#include <pico/stdlib.h>
+
+#include "arcade.h"
+#include "assets.h"
+#include "audio.h"
+#include "draw.h"
+#include "infrared.h"
+#include "vga.h"
+
+#define BREAKOUT_COLS 10
+#define BREAKOUT_ROWS 10
+#define BREAKOUT_BRICKS (BREAKOUT_COLS * BREAKOUT_ROWS)
+
+// -------- Grid --------
+
+#define BREAKOUT_GRID_X 10 // Top left corner of the brick grid
+#define BREAKOUT_GRID_Y 30
+#define BREAKOUT_CELL_W 30 // One brick per cell, including the gap
+#define BREAKOUT_CELL_H 10
+#define BREAKOUT_BRICK_GAP 2
+
+// -------- Grid --------
+
+#define BREAKOUT_PADDLE_Y 220
+#define BREAKOUT_PADDLE_W 40
+#define BREAKOUT_PADDLE_H 5
+#define BREAKOUT_PADDLE_SPEED 6
+
+#define BREAKOUT_BALL_SIZE 6
+#define BREAKOUT_BALL_SPEED 2
+#define BREAKOUT_LIVES 3
+
+#define BREAKOUT_INPUT_NONE 0
+#define BREAKOUT_INPUT_LEFT 1
+#define BREAKOUT_INPUT_RIGHT 2
+
+#define BREAKOUT_DRAW_PADDLE 0 // Object ids for draw_move()
+#define BREAKOUT_DRAW_BALL 1
+
+// -------- Floor --------
+
+// A checkered floor drawn by scanout below the bricks, drifting forward and
+// slowly turning. The canvas stays black there, so it costs no drawing. Each
+// step makes core 1 compose every floor line again, so the floor only steps
+// every BREAKOUT_FLOOR_PERIOD ticks and its lines come from the scanline
+// cache in between.
+#define BREAKOUT_FLOOR_BITS 5 // 32x32 texels
+#define BREAKOUT_FLOOR_TILE 8 // Texels per checker square
+#define BREAKOUT_FLOOR_HORIZON                                                 \
+  (BREAKOUT_GRID_Y + BREAKOUT_ROWS * BREAKOUT_CELL_H)
+#define BREAKOUT_FLOOR_HEIGHT (12 << 8) // Eye over the floor, texels in 8.8
+#define BREAKOUT_FLOOR_PERIOD 8         // Ticks per step, about 4 steps/s
+#define BREAKOUT_FLOOR_SPEED 384        // 8.8 texels forward per step
+#define BREAKOUT_FLOOR_TURN 192         // Angle per step, a turn in 342
+
+// -------- Floor --------
+
+struct breakout_state {
+  uint8_t bricks[BREAKOUT_ROWS][BREAKOUT_COLS]; // 1 while the brick stands
+  uint16_t bricks_left;
+
+  uint16_t ball_x;
+  uint16_t ball_y;
+  uint16_t ball_x_old;
+  uint16_t ball_y_old;
+  int16_t v_x;
+  int16_t v_y;
+
+  uint16_t paddle_x;
+  uint16_t paddle_x_old;
+
+  uint8_t lives;
+
+  // Bricks destroyed since the last draw, the only ones that get redrawn
+  uint8_t destroyed[BREAKOUT_BRICKS];
+  uint8_t destroyed_count;
+
+  bool full_redraw;
+
+  uint16_t floor_v; // Eye position over the floor, 8.8
+  uint16_t floor_angle;
+  uint8_t floor_ticks; // Since the last step
+};
+
+static struct breakout_state bs;
+
+// Read by scanout for every floor pixel, so in RAM
+static uint16_t floor_texels[1 << (2 * BREAKOUT_FLOOR_BITS)];
+static const struct vga_texture floor_texture = {
+    .texels = floor_texels,
+    .width_bits = BREAKOUT_FLOOR_BITS,
+    .height_bits = BREAKOUT_FLOOR_BITS,
+};
+
+// Dim enough that the ball and the paddle stand out against it
+static void breakout_make_floor(void) {
+  for (uint y = 0; y < (1u << BREAKOUT_FLOOR_BITS); y++) {
+    for (uint x = 0; x < (1u << BREAKOUT_FLOOR_BITS); x++) {
+      bool dark = ((x ^ y) / BREAKOUT_FLOOR_TILE) & 1;
+      floor_texels[(y << BREAKOUT_FLOOR_BITS) + x] =
+          dark ? (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x01, 0x02, 0x05)
+               : (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x03, 0x05, 0x09);
+    }
+  }
+}
+
+static void breakout_reset_ball(void) {
+  bs.ball_x = bs.paddle_x + BREAKOUT_PADDLE_W / 2 - BREAKOUT_BALL_SIZE / 2;
+  bs.ball_y = BREAKOUT_PADDLE_Y - 40;
+  bs.v_x = BREAKOUT_BALL_SPEED;
+  bs.v_y = -BREAKOUT_BALL_SPEED;
+}
+
+static void breakout_init(void) {
+  for (uint row = 0; row < BREAKOUT_ROWS; row++) {
+    for (uint col = 0; col < BREAKOUT_COLS; col++) {
+      bs.bricks[row][col] = 1;
+    }
+  }
+  bs.bricks_left = BREAKOUT_BRICKS;
+
+  bs.paddle_x = (CANVAS_WIDTH - BREAKOUT_PADDLE_W) / 2;
+  bs.paddle_x_old = bs.paddle_x;
+  bs.lives = BREAKOUT_LIVES;
+
+  breakout_reset_ball();
+  bs.ball_x_old = bs.ball_x;
+  bs.ball_y_old = bs.ball_y;
+
+  bs.destroyed_count = 0;
+  bs.full_redraw = true;
+
+  breakout_make_floor();
+}
+
+static uint8_t breakout_input(uint8_t command) {
+  switch (command) {
+  case IR_C_LEFT:
+    return BREAKOUT_INPUT_LEFT;
+  case IR_C_RIGHT:
+    return BREAKOUT_INPUT_RIGHT;
+  default:
+    return BREAKOUT_INPUT_NONE;
+  }
+}
+
+static bool breakout_overlaps(int x, int y, int w, int h, int ox, int oy,
+                              int ow, int oh) {
+  return x < ox + ow && x + w > ox && y < oy + oh && y + h > oy;
+}
+
+// Tests the ball against the bricks in the grid cells its box covers. That is
+// at most 2x2 cells, whatever the number of bricks.
+static void breakout_hit_bricks(void) {
+  int x = bs.ball_x - BREAKOUT_GRID_X;
+  int y = bs.ball_y - BREAKOUT_GRID_Y;
+  int x_old = bs.ball_x_old - BREAKOUT_GRID_X;
+
+  if (x + BREAKOUT_BALL_SIZE <= 0 || y + BREAKOUT_BALL_SIZE <= 0 ||
+      x >= BREAKOUT_COLS * BREAKOUT_CELL_W ||
+      y >= BREAKOUT_ROWS * BREAKOUT_CELL_H) {
+    return; // Nowhere near the grid
+  }
+
+  int col_first = x < 0 ? 0 : x / BREAKOUT_CELL_W;
+  int row_first = y < 0 ? 0 : y / BREAKOUT_CELL_H;
+  int col_last = (x + BREAKOUT_BALL_SIZE - 1) / BREAKOUT_CELL_W;
+  int row_last = (y + BREAKOUT_BALL_SIZE - 1) / BREAKOUT_CELL_H;
+  if (col_last >= BREAKOUT_COLS) {
+    col_last = BREAKOUT_COLS - 1;
+  }
+  if (row_last >= BREAKOUT_ROWS) {
+    row_last = BREAKOUT_ROWS - 1;
+  }
+
+  bool flip_x = false;
+  bool flip_y = false;
+  for (int row = row_first; row <= row_last; row++) {
+    for (int col = col_first; col <= col_last; col++) {
+      if (!bs.bricks[row][col]) {
+        continue;
+      }
+
+      int brick_x = col * BREAKOUT_CELL_W;
+      int brick_y = row * BREAKOUT_CELL_H;
+      int brick_w = BREAKOUT_CELL_W - BREAKOUT_BRICK_GAP;
+      int brick_h = BREAKOUT_CELL_H - BREAKOUT_BRICK_GAP;
+      if (!breakout_overlaps(x, y, BREAKOUT_BALL_SIZE, BREAKOUT_BALL_SIZE,
+                             brick_x, brick_y, brick_w, brick_h)) {
+        continue;
+      }
+
+      bs.bricks[row][col] = 0;
+      bs.bricks_left--;
+      bs.destroyed[bs.destroyed_count++] =
+          (uint8_t)(row * BREAKOUT_COLS + col);
+
+      // Already level with the brick before this tick: it was hit from above
+      // or below, otherwise from the side
+      if (x_old < brick_x + brick_w && x_old + BREAKOUT_BALL_SIZE > brick_x) {
+        flip_y = true;
+      } else {
+        flip_x = true;
+      }
+    }
+  }
+
+  if (flip_x || flip_y) {
+    audio_play(AUDIO_BRICK);
+
+    // Step back out of the brick so the ball never paints over one
+    bs.ball_x = bs.ball_x_old;
+    bs.ball_y = bs.ball_y_old;
+    bs.v_x = flip_x ? -bs.v_x : bs.v_x;
+    bs.v_y = flip_y ? -bs.v_y : bs.v_y;
+  }
+}
+
+static void breakout_update(uint8_t input) {
+  // Move the paddle
+  bs.paddle_x_old = bs.paddle_x;
+  if (input == BREAKOUT_INPUT_LEFT) {
+    bs.paddle_x = bs.paddle_x > BREAKOUT_PADDLE_SPEED
+                      ? bs.paddle_x - BREAKOUT_PADDLE_SPEED
+                      : 0;
+  } else if (input == BREAKOUT_INPUT_RIGHT) {
+    bs.paddle_x += BREAKOUT_PADDLE_SPEED;
+    if (bs.paddle_x > CANVAS_WIDTH - BREAKOUT_PADDLE_W) {
+      bs.paddle_x = CANVAS_WIDTH - BREAKOUT_PADDLE_W;
+    }
+  }
+
+  // Move the ball
+  bs.ball_x_old = bs.ball_x;
+  bs.ball_y_old = bs.ball_y;
+  int x = bs.ball_x + bs.v_x;
+  int y = bs.ball_y + bs.v_y;
+
+  // Side and top walls
+  if (x < 0 || x > (int)CANVAS_WIDTH - BREAKOUT_BALL_SIZE) {
+    x = x < 0 ? 0 : (int)CANVAS_WIDTH - BREAKOUT_BALL_SIZE;
+    bs.v_x = -bs.v_x;
+    audio_play(AUDIO_WALL);
+  }
+  if (y < 0) {
+    y = 0;
+    bs.v_y = -bs.v_y;
+    audio_play(AUDIO_WALL);
+  }
+  bs.ball_x = (uint16_t)x;
+  bs.ball_y = (uint16_t)y;
+
+  breakout_hit_bricks();
+
+  // Paddle, the bounce angle depends on where the ball lands
+  if (bs.v_y > 0 &&
+      breakout_overlaps(bs.ball_x, bs.ball_y, BREAKOUT_BALL_SIZE,
+                        BREAKOUT_BALL_SIZE, bs.paddle_x, BREAKOUT_PADDLE_Y,
+                        BREAKOUT_PADDLE_W, BREAKOUT_PADDLE_H)) {
+    int offset = (bs.ball_x + BREAKOUT_BALL_SIZE / 2) -
+                 (bs.paddle_x + BREAKOUT_PADDLE_W / 2);
+    int v_x = offset / 6;
+    if (v_x == 0) {
+      v_x = bs.v_x < 0 ? -1 : 1;
+    } else if (v_x > 3) {
+      v_x = 3;
+    } else if (v_x < -3) {
+      v_x = -3;
+    }
+
+    bs.ball_y = BREAKOUT_PADDLE_Y - BREAKOUT_BALL_SIZE;
+    bs.v_x = (int16_t)v_x;
+    bs.v_y = -bs.v_y;
+    audio_play(AUDIO_PADDLE);
+  }
+
+  // Missed the ball
+  if (bs.ball_y + BREAKOUT_BALL_SIZE >= CANVAS_HEIGHT) {
+    audio_play(AUDIO_SCORE);
+    if (--bs.lives == 0) {
+      breakout_init();
+      return;
+    }
+    breakout_reset_ball();
+  }
+
+  if (bs.bricks_left == 0) {
+    breakout_init();
+  }
+
+  if (++bs.floor_ticks == BREAKOUT_FLOOR_PERIOD) {
+    bs.floor_ticks = 0;
+    bs.floor_v -= BREAKOUT_FLOOR_SPEED;
+    bs.floor_angle += BREAKOUT_FLOOR_TURN;
+  }
+}
+
+static uint16_t breakout_row_color(uint row) {
+  static const uint16_t colors[] = {
+      PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x1f, 0x04, 0x04),
+      PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x1f, 0x10, 0x02),
+      PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x1f, 0x1c, 0x02),
+      PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x06, 0x1a, 0x06),
+      PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x04, 0x10, 0x1f),
+  };
+  return colors[(row / 2) % (sizeof(colors) / sizeof(colors[0]))];
+}
+
+static void breakout_fill_brick(struct draw_list *list, uint brick,
+                                uint16_t color) {
+  uint row = brick / BREAKOUT_COLS;
+  uint col = brick % BREAKOUT_COLS;
+  uint16_t x = BREAKOUT_GRID_X + col * BREAKOUT_CELL_W;
+  uint16_t y = BREAKOUT_GRID_Y + row * BREAKOUT_CELL_H;
+  uint16_t w = BREAKOUT_CELL_W - BREAKOUT_BRICK_GAP;
+  uint16_t h = BREAKOUT_CELL_H - BREAKOUT_BRICK_GAP;
+
+  draw_fill(list, x, y, w, h, color);
+}
+
+static void breakout_draw(struct draw_list *list) {
+  uint16_t ball_color =
+      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x1f, 0x1f, 0x1f);
+  uint16_t paddle_color =
+      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x08, 0x18, 0x1f);
+
+  if (list->lost) {
+    bs.full_redraw = true;
+    list->lost = false;
+  }
+
+  if (bs.full_redraw) {
+    draw_clear(list);
+
+    for (uint brick = 0; brick < BREAKOUT_BRICKS; brick++) {
+      uint row = brick / BREAKOUT_COLS;
+      if (bs.bricks[row][brick % BREAKOUT_COLS]) {
+        breakout_fill_brick(list, brick, breakout_row_color(row));
+      }
+    }
+
+    bs.full_redraw = false;
+    bs.destroyed_count = 0;
+  }
+
+  // Only the bricks that went away since the last frame
+  for (uint i = 0; i < bs.destroyed_count; i++) {
+    breakout_fill_brick(list, bs.destroyed[i], 0);
+  }
+  bs.destroyed_count = 0;
+
+  draw_move(list, BREAKOUT_DRAW_PADDLE, bs.paddle_x_old, BREAKOUT_PADDLE_Y,
+            bs.paddle_x, BREAKOUT_PADDLE_Y, BREAKOUT_PADDLE_W,
+            BREAKOUT_PADDLE_H, paddle_color);
+
+  draw_move(list, BREAKOUT_DRAW_BALL, bs.ball_x_old, bs.ball_y_old, bs.ball_x,
+            bs.ball_y, BREAKOUT_BALL_SIZE, BREAKOUT_BALL_SIZE, ball_color);
+
+  struct vga_background floor = {
+      .texture = &floor_texture,
+      .mode = VGA_BACKGROUND_FLOOR,
+      .horizon = BREAKOUT_FLOOR_HORIZON,
+      .v = bs.floor_v,
+      .angle = bs.floor_angle,
+      .scale = BREAKOUT_FLOOR_HEIGHT,
+  };
+  draw_background(list, &floor);
+
+  // Remaining lives in the top left corner
+  const struct sprite *heart = &sprite_heart;
+  for (uint i = 0; i < BREAKOUT_LIVES; i++) {
+    uint16_t x = (uint16_t)(4 + i * (heart->width + 3));
+    if (i < bs.lives) {
+      draw_sprite(list, x, 10, heart);
+    } else {
+      draw_fill(list, x, 10, heart->width, heart->height, 0);
+    }
+  }
+}
+
+const struct arcade_game breakout_game = {
+    .name = "Breakout",
+    .init = breakout_init,
+    .input = breakout_input,
+    .update = breakout_update,
+    .draw = breakout_draw,
+};
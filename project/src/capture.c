@@ -0,0 +1,133 @@
+#include <FreeRTOS.h>
+#include <pico/stdio_usb.h>
+#include <string.h>
+#include <task.h>
+
+#include "capture.h"
+#include "usb_stream.h"
+#include "vga.h"
+
+// What the host was last sent for each screen line
+struct capture_line {
+  const uint16_t *source;
+  uint16_t version;
+  bool sent;
+};
+
+static struct capture_line sent_lines[CANVAS_ROWS];
+
+static void put_le16(uint8_t *dest, uint16_t value) {
+  dest[0] = (uint8_t)value;
+  dest[1] = (uint8_t)(value >> 8);
+}
+
+// Run-length encodes one line into as many records as it takes. Returns the
+// bytes written, or 0 if the host went away.
+static uint32_t capture_send_line(uint16_t line, const uint16_t *pixels) {
+  uint8_t record[USB_STREAM_MAX_PAYLOAD];
+  uint32_t total = 0;
+
+  uint x = 0;
+  while (x < CANVAS_WIDTH) {
+    record[0] = CAPTURE_RECORD_LINE;
+    put_le16(&record[1], line);
+    put_le16(&record[3], (uint16_t)x);
+    uint len = 5;
+
+    while (x < CANVAS_WIDTH && len + 3 <= sizeof(record)) {
+      uint16_t pixel = pixels[x];
+      uint run = 1;
+      while (x + run < CANVAS_WIDTH && run < 256 && pixels[x + run] == pixel) {
+        run++;
+      }
+
+      record[len] = (uint8_t)(run - 1);
+      put_le16(&record[len + 1], pixel);
+      len += 3;
+      x += run;
+    }
+
+    if (!usb_stream_write(USB_STREAM_CAPTURE, record, (uint16_t)len)) {
+      return 0;
+    }
+    total += len;
+  }
+
+  return total;
+}
+
+static void capture_send_frame(uint16_t frame, uint16_t sent,
+                               uint16_t pending) {
+  uint8_t record[7];
+  record[0] = CAPTURE_RECORD_FRAME;
+  put_le16(&record[1], frame);
+  put_le16(&record[3], sent);
+  put_le16(&record[5], pending);
+  usb_stream_write(USB_STREAM_CAPTURE, record, sizeof(record));
+}
+
+void capture_task(void *pvParameters) {
+  (void)pvParameters;
+
+  static uint16_t pixels[CANVAS_COLUMNS];
+  uint16_t frame = 0;
+  uint first = 0; // Where the last budget-limited frame stopped
+
+  TickType_t xLastWakeTime = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(CAPTURE_PERIOD_MS));
+
+    if (!stdio_usb_connected()) {
+      // Whoever connects next starts from a black screen
+      memset(sent_lines, 0, sizeof(sent_lines));
+      continue;
+    }
+
+    // Lines lost in a stale read, or a host that attached midway, catch up
+    if (frame % CAPTURE_KEYFRAME_FRAMES == 0) {
+      memset(sent_lines, 0, sizeof(sent_lines));
+    }
+
+    uint32_t budget = CAPTURE_FRAME_BUDGET;
+    uint16_t sent = 0;
+    uint16_t pending = 0;
+    uint next_first = first;
+
+    for (uint i = 0; i < CANVAS_HEIGHT; i++) {
+      uint line = (first + i) % CANVAS_HEIGHT;
+      struct capture_line *last = &sent_lines[line];
+
+      // Version before pixels, so a write landing during the copy shows up
+      // as a change next frame. Keyframes mop up anything that slips past.
+      uint16_t version = vga_get_scanout_version(line);
+      const uint16_t *source = vga_get_scanout_line(line);
+      if (last->sent && last->source == source && last->version == version) {
+        continue;
+      }
+
+      // Room for the worst case, a line without a single repeat
+      if (budget < 3u * CANVAS_WIDTH + 5u * 4) {
+        if (pending++ == 0) {
+          next_first = line; // Next frame starts with what did not fit
+        }
+        continue;
+      }
+
+      memcpy(pixels, source, sizeof(pixels));
+      uint32_t len = capture_send_line((uint16_t)line, pixels);
+      if (len == 0) {
+        break;
+      }
+
+      budget -= MIN(budget, len);
+      last->source = source;
+      last->version = version;
+      last->sent = true;
+      sent++;
+    }
+
+    first = next_first;
+    capture_send_frame(frame++, sent, pending);
+  }
+}
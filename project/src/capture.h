@@ -0,0 +1,34 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <pico.h>
+
+// Streams what the screen shows to the host over USB (USB_STREAM_CAPTURE).
+// A line is only sent again once the canvas row behind it was written to or
+// the view moved another row onto it, and every line goes out run-length
+// encoded. tools/capture2ppm.py rebuilds the frames as PPM files or video.
+
+#define CAPTURE_PERIOD_MS 100      // One frame every this often
+#define CAPTURE_FRAME_BUDGET 24576 // Bytes per frame, the rest waits
+#define CAPTURE_KEYFRAME_FRAMES 50 // Every line is resent this often
+
+// -------- Stream format --------
+//
+// USB_STREAM_CAPTURE payloads start with a record kind:
+//   CAPTURE_RECORD_LINE:  kind | line (LE16) | x (LE16) | runs
+//   CAPTURE_RECORD_FRAME: kind | frame (LE16) | lines sent (LE16) |
+//                         lines still pending (LE16)
+//
+// A run is count - 1 (u8) and an RGB555 pixel (LE16). A line too long for one
+// payload continues in another record at the x where the last one stopped.
+// Lines arrive in any order, the frame record closes the frame.
+
+#define CAPTURE_RECORD_LINE 0
+#define CAPTURE_RECORD_FRAME 1
+
+// -------- Stream format --------
+
+// Low priority FreeRTOS task, only reads the canvas and never takes a lock
+void capture_task(void *pvParameters);
+
+#endif
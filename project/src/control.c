@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <string.h>
+
+#include "control.h"
+#include "frame.h"
+#include "infrared.h"
+
+static_assert(sizeof(struct control_reply) == 12, "tools/control.py REPLY");
+
+static bool control_payload_valid(const uint8_t *frame) {
+  return frame[6] == 0;
+}
+
+static const struct frame_format control_frame = {
+    .sync = CONTROL_SYNC,
+    .size = CONTROL_PACKET_SIZE,
+    .valid = control_payload_valid,
+};
+
+bool control_decode(struct control_decoder *decoder, uint8_t byte,
+                    struct control_packet *packet) {
+  if (!frame_decode(&control_frame, decoder->buf, &decoder->used, byte)) {
+    return false;
+  }
+
+  packet->type = decoder->buf[1];
+  packet->seq = decoder->buf[2];
+  packet->arg = decoder->buf[3];
+  packet->value = (int16_t)(decoder->buf[4] | decoder->buf[5] << 8);
+  return true;
+}
+
+// -------- Device side --------
+
+bool control_is_command(uint8_t arg) {
+  switch (arg) {
+  case IR_C_RIGHT:
+  case IR_C_LEFT:
+  case IR_C_UP:
+  case IR_C_DOWN:
+  case IR_C_N1:
+  case IR_C_N2:
+  case IR_C_N3:
+  case IR_C_N4:
+  case IR_C_N5:
+  case IR_C_N6:
+  case IR_C_N7:
+  case IR_C_N8:
+  case IR_C_N9:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Moves the input on if it is still in state `from`. The logic task and the
+// timeout may both try, only one of them wins.
+static bool control_input_move(struct control_device *device, uint8_t from,
+                               uint8_t to) {
+  return __atomic_compare_exchange_n(&device->input_state, &from, to, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static uint8_t control_input(struct control_device *device,
+                             const struct control_packet *packet) {
+  if (!control_is_command(packet->arg)) {
+    return CONTROL_BAD_ARG;
+  }
+  if (__atomic_load_n(&device->input_state, __ATOMIC_ACQUIRE) !=
+      CONTROL_INPUT_IDLE) {
+    return CONTROL_BUSY; // One command per tick
+  }
+
+  device->input_packet = *packet;
+  device->received_at = device->now_us();
+  __atomic_store_n(&device->input_state, CONTROL_INPUT_WAITING,
+                   __ATOMIC_RELEASE);
+  device->input(packet->arg);
+  return CONTROL_OK;
+}
+
+void control_handle(struct control_device *device,
+                    const struct control_packet *packet) {
+  int32_t value = 0;
+  uint8_t status;
+
+  switch (packet->type) {
+  case CONTROL_PING:
+    status = CONTROL_OK;
+    break;
+  case CONTROL_INPUT:
+    status = control_input(device, packet);
+    if (status == CONTROL_OK) {
+      return; // Answered by control_poll() once a tick has used it
+    }
+    break;
+  case CONTROL_SET:
+    status = device->set(packet->arg, packet->value);
+    break;
+  case CONTROL_GET:
+    status = device->get(packet->arg, &value);
+    break;
+  default:
+    status = CONTROL_BAD_TYPE;
+    break;
+  }
+
+  device->reply(packet, status, value);
+}
+
+void control_input_used(struct control_device *device) {
+  device->used_at = device->now_us();
+  control_input_move(device, CONTROL_INPUT_WAITING, CONTROL_INPUT_USED);
+}
+
+void control_poll(struct control_device *device) {
+  uint8_t state = __atomic_load_n(&device->input_state, __ATOMIC_ACQUIRE);
+
+  if (state == CONTROL_INPUT_USED) {
+    device->reply(&device->input_packet, CONTROL_OK,
+                  (int32_t)(device->used_at - device->received_at));
+    __atomic_store_n(&device->input_state, CONTROL_INPUT_IDLE,
+                     __ATOMIC_RELEASE);
+  } else if (state == CONTROL_INPUT_WAITING &&
+             device->now_us() - device->received_at >=
+                 CONTROL_INPUT_TIMEOUT_US &&
+             control_input_move(device, CONTROL_INPUT_WAITING,
+                                CONTROL_INPUT_IDLE)) {
+    device->reply(&device->input_packet, CONTROL_TIMEOUT, 0);
+  }
+}
+
+// -------- Device side --------
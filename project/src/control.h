@@ -0,0 +1,122 @@
+#ifndef _CONTROL_H_
+#define _CONTROL_H_
+
+#include <pico.h>
+
+// Binary control protocol read from the USB stdio input, a faster stand-in
+// for the IR remote that also takes parameter changes and state queries. The
+// host sends fixed-size packets and no text is ever parsed:
+//
+// CONTROL_SYNC | type | seq | arg | value (LE16) | 0 | checksum
+//
+// The checksum is the XOR of the bytes between the sync and itself. Bytes
+// that do not start a valid packet are skipped one at a time, so the decoder
+// finds its way back after noise. Every packet is answered with one
+// struct control_reply in a USB_STREAM_CONTROL frame. tools/control.py is
+// the host side.
+
+#define CONTROL_SYNC 0x5A
+#define CONTROL_PACKET_SIZE 8
+
+enum control_type {
+  CONTROL_PING = 1,  // Answered straight away, times the link alone
+  CONTROL_INPUT = 2, // arg = IR command, answered once a tick has used it
+  CONTROL_SET = 3,   // arg = enum control_param, value = new value
+  CONTROL_GET = 4,   // arg = enum control_state
+};
+
+enum control_param {
+  CONTROL_PARAM_GAME = 0,    // Game table index, the game restarts
+  CONTROL_PARAM_TICK_MS = 1, // Logic tick period
+};
+
+enum control_state {
+  CONTROL_STATE_TICKS = 0,       // Logic ticks since boot
+  CONTROL_STATE_GAME = 1,        // Game table index
+  CONTROL_STATE_LATENCY_IR = 2,  // Last input-to-photon time in us
+  CONTROL_STATE_LATENCY_USB = 3, // Same for CONTROL_INPUT
+};
+
+enum control_status {
+  CONTROL_OK = 0,
+  CONTROL_BAD_TYPE = 1,
+  CONTROL_BAD_ARG = 2, // Unknown arg, value out of range or not a command
+  CONTROL_BUSY = 3,    // The previous input has not been used yet
+  CONTROL_TIMEOUT = 4, // No tick used the input within the timeout
+};
+
+struct control_packet {
+  uint8_t type; // enum control_type
+  uint8_t seq;  // Echoed in the reply
+  uint8_t arg;
+  int16_t value;
+};
+
+// USB_STREAM_CONTROL payload, little endian
+struct control_reply {
+  uint8_t type; // Of the packet answered
+  uint8_t seq;
+  uint8_t status; // enum control_status
+  uint8_t arg;
+  int32_t value;    // GET: the state, INPUT: us from arrival to the tick
+  uint32_t time_us; // Device clock when the reply was made
+};
+
+struct control_decoder {
+  uint8_t buf[CONTROL_PACKET_SIZE];
+  uint8_t used;
+};
+
+// Feeds one received byte. Returns true when it completed a valid packet,
+// which is then in *packet.
+bool control_decode(struct control_decoder *decoder, uint8_t byte,
+                    struct control_packet *packet);
+
+// -------- Device side --------
+
+// An input no tick has used by then is answered with CONTROL_TIMEOUT, so a
+// lost command does not leave every later input BUSY
+#define CONTROL_INPUT_TIMEOUT_US 500000
+
+enum control_input_state {
+  CONTROL_INPUT_IDLE,
+  CONTROL_INPUT_WAITING, // Handed to the logic task
+  CONTROL_INPUT_USED,    // A tick used it, the reply is due
+};
+
+// The firmware and host/control_loopback.c answer packets through the same
+// handler and only differ in these hooks
+struct control_device {
+  void (*reply)(const struct control_packet *packet, uint8_t status,
+                int32_t value);
+  uint8_t (*set)(uint8_t param, int16_t value); // enum control_status
+  uint8_t (*get)(uint8_t state, int32_t *value);
+  void (*input)(uint8_t command); // Hands an IR command to the next tick
+  uint32_t (*now_us)(void);
+
+  // The input in flight, one at a time
+  volatile uint8_t input_state; // enum control_input_state
+  struct control_packet input_packet;
+  uint32_t received_at;
+  uint32_t used_at;
+};
+
+// Whether `arg` is an IR command an input may carry. IR_C_OK means "no
+// command" to the logic task and is not one.
+bool control_is_command(uint8_t arg);
+
+// Answers a packet. An input is handed on and answered later by
+// control_poll().
+void control_handle(struct control_device *device,
+                    const struct control_packet *packet);
+
+// Called by the logic task after a tick that used a command
+void control_input_used(struct control_device *device);
+
+// Answers the input in flight once a tick has used it or it timed out. Call
+// it from the task that calls control_handle().
+void control_poll(struct control_device *device);
+
+// -------- Device side --------
+
+#endif
@@ -0,0 +1,455 @@
+#include <string.h>
+
+#include "draw.h"
+#include "jobs.h"
+#include "raster.h"
+#include "vga.h"
+
+// One bit per pixel, rows top to bottom, most significant bit on the left
+static const uint16_t glyphs[36] = {
+    0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, // 0-7
+    0x7bef, 0x7bcf, 0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, // 8-F
+    0x396b, 0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927, 0x5fed, 0x6b6d, // G-N
+    0x2b6a, 0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f, 0x5b6a, // O-V
+    0x5bfd, 0x5aad, 0x5a92, 0x72a7,                                 // W-Z
+};
+
+void draw_list_reset(struct draw_list *list) {
+  list->count = 0;
+  memset(list->move_slot, 0, sizeof(list->move_slot));
+  list->latency_probe = false;
+}
+
+// Starts the list over with a clear. The view and the background outlive
+// clears, so the last change of each is kept.
+static void draw_restart(struct draw_list *list) {
+  struct draw_cmd view = {.op = DRAW_CLEAR};
+  struct draw_cmd background = {.op = DRAW_CLEAR};
+  for (uint16_t i = 0; i < list->count; i++) {
+    if (list->cmds[i].op == DRAW_VIEW) {
+      view = list->cmds[i];
+    } else if (list->cmds[i].op == DRAW_BACKGROUND) {
+      background = list->cmds[i];
+    }
+  }
+
+  bool latency_probe = list->latency_probe;
+  draw_list_reset(list);
+  list->latency_probe = latency_probe;
+  list->cmds[list->count++].op = DRAW_CLEAR;
+  if (view.op == DRAW_VIEW) {
+    list->cmds[list->count++] = view;
+  }
+  if (background.op == DRAW_BACKGROUND) {
+    list->cmds[list->count++] = background;
+  }
+}
+
+struct draw_box {
+  uint32_t x0;
+  uint32_t y0;
+  uint32_t x1; // Exclusive
+  uint32_t y1;
+};
+
+static struct draw_box draw_box_of(uint16_t x, uint16_t y, uint16_t w,
+                                   uint16_t h) {
+  return (struct draw_box){x, y, (uint32_t)x + w, (uint32_t)y + h};
+}
+
+// Both places of a move, one box is close enough for a step of a few pixels
+static struct draw_box draw_box_of_move(const struct draw_cmd *cmd) {
+  struct draw_box from = draw_box_of(cmd->move.x_old, cmd->move.y_old,
+                                     cmd->w, cmd->h);
+  struct draw_box to = draw_box_of(cmd->x, cmd->y, cmd->w, cmd->h);
+  return (struct draw_box){MIN(from.x0, to.x0), MIN(from.y0, to.y0),
+                           MAX(from.x1, to.x1), MAX(from.y1, to.y1)};
+}
+
+static bool draw_box_overlap(struct draw_box a, struct draw_box b) {
+  return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+// Pixels a recorded command may touch, false for those that touch none
+static bool draw_box_of_cmd(const struct draw_cmd *cmd, struct draw_box *box) {
+  switch (cmd->op) {
+  case DRAW_MOVE:
+    *box = draw_box_of_move(cmd);
+    return true;
+  case DRAW_TEXT:
+    *box = draw_box_of(cmd->x, cmd->y, DRAW_TEXT_MAX * DRAW_GLYPH_ADVANCE,
+                       DRAW_GLYPH_H);
+    return true;
+  case DRAW_CLEAR:
+    *box = (struct draw_box){0, 0, UINT32_MAX, UINT32_MAX};
+    return true;
+  case DRAW_VIEW:
+  case DRAW_BACKGROUND:
+    return false;
+  default:
+    *box = draw_box_of(cmd->x, cmd->y, cmd->w, cmd->h);
+    return true;
+  }
+}
+
+// Whether the list already ends on `cmd` as far as its pixels go: an equal
+// command recorded earlier with nothing since drawn over the same place
+static bool draw_is_redundant(const struct draw_list *list,
+                              const struct draw_cmd *cmd) {
+  struct draw_box box = draw_box_of(cmd->x, cmd->y, cmd->w, cmd->h);
+  for (uint16_t i = list->count; i-- > 0;) {
+    const struct draw_cmd *other = &list->cmds[i];
+    if (other->op == cmd->op && other->x == cmd->x && other->y == cmd->y &&
+        other->w == cmd->w && other->h == cmd->h &&
+        other->color == cmd->color &&
+        (cmd->op != DRAW_NET || (other->net.dash == cmd->net.dash &&
+                                 other->net.gap == cmd->net.gap))) {
+      return true;
+    }
+
+    struct draw_box touched;
+    if (draw_box_of_cmd(other, &touched) && draw_box_overlap(box, touched)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+static struct draw_cmd *draw_push(struct draw_list *list, uint8_t op) {
+  if (list->count >= DRAW_LIST_SIZE) {
+    // Keep going from a blank canvas rather than showing a partial frame
+    draw_restart(list);
+    list->lost = true;
+  }
+
+  struct draw_cmd *cmd = &list->cmds[list->count++];
+  cmd->op = op;
+  return cmd;
+}
+
+void draw_fill(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+               uint16_t h, uint16_t color) {
+  struct draw_cmd fill = {
+      .op = DRAW_FILL, .color = color, .x = x, .y = y, .w = w, .h = h};
+  if (draw_is_redundant(list, &fill)) {
+    return;
+  }
+
+  *draw_push(list, DRAW_FILL) = fill;
+}
+
+void draw_move(struct draw_list *list, uint16_t id, uint16_t x_old,
+               uint16_t y_old, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+               uint16_t color) {
+  draw_move_round(list, id, x_old, y_old, x, y, w, h, 0, color);
+}
+
+void draw_move_round(struct draw_list *list, uint16_t id, uint16_t x_old,
+                     uint16_t y_old, uint16_t x, uint16_t y, uint16_t w,
+                     uint16_t h, uint8_t radius, uint16_t color) {
+  if (id >= DRAW_MAX_IDS) {
+    return;
+  }
+
+  // A second move in the same list keeps the first erase position and only
+  // lands the object somewhere else
+  uint16_t slot = list->move_slot[id];
+  if (slot) {
+    struct draw_cmd *cmd = &list->cmds[slot - 1];
+    cmd->x = x;
+    cmd->y = y;
+    cmd->color = color;
+    return;
+  }
+
+  struct draw_cmd *cmd = draw_push(list, DRAW_MOVE);
+  cmd->x = x;
+  cmd->y = y;
+  cmd->w = w;
+  cmd->h = h;
+  cmd->color = color;
+  cmd->move.x_old = x_old;
+  cmd->move.y_old = y_old;
+  cmd->move.radius = radius;
+  list->move_slot[id] = list->count;
+}
+
+void draw_net(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+              uint16_t h, uint8_t dash, uint8_t gap, uint16_t color) {
+  struct draw_cmd net = {.op = DRAW_NET,
+                         .color = color,
+                         .x = x,
+                         .y = y,
+                         .w = w,
+                         .h = h,
+                         .net = {.dash = dash, .gap = gap}};
+  if (draw_is_redundant(list, &net)) {
+    return;
+  }
+
+  *draw_push(list, DRAW_NET) = net;
+}
+
+void draw_text(struct draw_list *list, uint16_t x, uint16_t y,
+               const char *text, uint16_t color) {
+  struct draw_cmd *cmd = draw_push(list, DRAW_TEXT);
+  cmd->x = x;
+  cmd->y = y;
+  cmd->color = color;
+  strncpy(cmd->text, text, DRAW_TEXT_MAX);
+}
+
+void draw_fade(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+               uint16_t h, uint16_t color, uint8_t alpha) {
+  struct draw_cmd *cmd = draw_push(list, DRAW_FADE);
+  cmd->x = x;
+  cmd->y = y;
+  cmd->w = w;
+  cmd->h = h;
+  cmd->color = color;
+  cmd->alpha = alpha;
+}
+
+void draw_clear(struct draw_list *list) { draw_restart(list); }
+
+void draw_sprite(struct draw_list *list, uint16_t x, uint16_t y,
+                 const struct sprite *sprite) {
+  struct draw_cmd *cmd = draw_push(list, DRAW_SPRITE);
+  cmd->x = x;
+  cmd->y = y;
+  cmd->w = sprite->width;
+  cmd->h = sprite->height;
+  cmd->sprite = sprite;
+}
+
+void draw_view(struct draw_list *list, uint16_t scroll, uint16_t split,
+               uint16_t split_scroll, int16_t shake) {
+  struct draw_cmd *cmd = draw_push(list, DRAW_VIEW);
+  cmd->x = scroll;
+  cmd->view.split = split;
+  cmd->view.split_scroll = split_scroll;
+  cmd->view.shake = shake;
+}
+
+void draw_background(struct draw_list *list,
+                     const struct vga_background *background) {
+  struct draw_cmd *cmd = draw_push(list, DRAW_BACKGROUND);
+  cmd->x = background->u;
+  cmd->y = background->v;
+  cmd->w = background->angle;
+  cmd->h = background->scale;
+  cmd->background.texture = background->texture;
+  cmd->background.horizon = background->horizon;
+  cmd->background.mode = background->mode;
+}
+
+const struct draw_cmd *draw_find_move(const struct draw_list *list,
+                                      uint16_t id) {
+  if (id >= DRAW_MAX_IDS || list->move_slot[id] == 0) {
+    return NULL;
+  }
+  return &list->cmds[list->move_slot[id] - 1];
+}
+
+void draw_queue_init(struct draw_queue *queue) {
+  memset(queue->lists, 0, sizeof(queue->lists));
+  queue->writer = &queue->lists[0];
+  queue->pending = &queue->lists[1];
+  queue->reader = &queue->lists[2];
+  queue->lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+struct draw_list *draw_queue_writer(struct draw_queue *queue) {
+  return queue->writer;
+}
+
+void draw_queue_publish(struct draw_queue *queue) {
+  uint32_t irq = spin_lock_blocking(queue->lock);
+  if (queue->pending->count == 0) {
+    struct draw_list *recorded = queue->writer;
+    queue->writer = queue->pending;
+    queue->pending = recorded;
+
+    // The game learns about dropped commands from the list it draws into
+    queue->writer->lost = recorded->lost;
+    recorded->lost = false;
+  }
+  spin_unlock(queue->lock, irq);
+}
+
+struct draw_list *draw_queue_take(struct draw_queue *queue) {
+  // Whatever was taken last time has been drawn by now
+  draw_list_reset(queue->reader);
+
+  uint32_t irq = spin_lock_blocking(queue->lock);
+  struct draw_list *taken = NULL;
+  if (queue->pending->count != 0) {
+    taken = queue->pending;
+    queue->pending = queue->reader;
+    queue->reader = taken;
+  }
+  spin_unlock(queue->lock, irq);
+
+  return taken;
+}
+
+static void draw_glyphs(const struct draw_cmd *cmd, uint16_t *canvas) {
+  uint16_t x = cmd->x;
+
+  for (uint i = 0; i < DRAW_TEXT_MAX && cmd->text[i]; i++) {
+    char c = cmd->text[i];
+    uint16_t glyph = 0;
+    if (c >= '0' && c <= '9') {
+      glyph = glyphs[c - '0'];
+    } else if (c >= 'A' && c <= 'Z') {
+      glyph = glyphs[10 + c - 'A'];
+    } else if (c >= 'a' && c <= 'z') {
+      glyph = glyphs[10 + c - 'a'];
+    }
+
+    for (uint row = 0; row < DRAW_GLYPH_H; row++) {
+      for (uint col = 0; col < DRAW_GLYPH_W; col++) {
+        uint bit = (DRAW_GLYPH_H - 1 - row) * DRAW_GLYPH_W +
+                   (DRAW_GLYPH_W - 1 - col);
+        vga_fill_rectangle(canvas, x + col, cmd->y + row, 1, 1,
+                           (glyph >> bit) & 1 ? cmd->color : 0);
+      }
+    }
+    x += DRAW_GLYPH_ADVANCE;
+  }
+}
+
+// Rectangles with jobs still in flight, anything drawn over one of them has
+// to wait for the batch so the later command stays on top
+#define DRAW_QUEUED_BOXES 16
+
+struct draw_batch {
+  struct jobs_batch jobs;
+  uint8_t count;
+  struct draw_box boxes[DRAW_QUEUED_BOXES];
+};
+
+static void draw_batch_wait(struct draw_batch *batch) {
+  jobs_wait(&batch->jobs);
+  batch->count = 0;
+}
+
+// Call before drawing over `box`, inline or queued
+static void draw_batch_order(struct draw_batch *batch, struct draw_box box) {
+  for (uint8_t i = 0; i < batch->count; i++) {
+    if (draw_box_overlap(box, batch->boxes[i])) {
+      draw_batch_wait(batch);
+      return;
+    }
+  }
+}
+
+// Call after queueing jobs over `box`
+static void draw_batch_queued(struct draw_batch *batch, struct draw_box box) {
+  if (batch->count == DRAW_QUEUED_BOXES) {
+    draw_batch_wait(batch);
+  }
+  batch->boxes[batch->count++] = box;
+}
+
+void draw_execute(const struct draw_list *list, uint16_t *canvas,
+                  const struct draw_lock *lock) {
+  struct draw_batch batch = {0};
+  struct raster_target target = vga_raster_target(canvas);
+  uint8_t phase = DRAW_CLEAR;
+  bool locked = false;
+
+  for (uint16_t i = 0; i < list->count; i++) {
+    const struct draw_cmd *cmd = &list->cmds[i];
+
+    if (!locked) {
+      lock->enter();
+      locked = true;
+    }
+
+    // A change of kind waits for the previous run to land, within a run
+    // only commands that overlap queued ones wait (draw_batch_order())
+    if (cmd->op != phase) {
+      draw_batch_wait(&batch);
+      phase = cmd->op;
+    }
+
+    switch (cmd->op) {
+    case DRAW_FILL: {
+      struct draw_box box = draw_box_of(cmd->x, cmd->y, cmd->w, cmd->h);
+      draw_batch_order(&batch, box);
+      jobs_fill_rect(&batch.jobs, canvas, cmd->x, cmd->y, cmd->w, cmd->h,
+                     cmd->color);
+      draw_batch_queued(&batch, box);
+      break;
+    }
+    case DRAW_MOVE: {
+      // Balls of a multi-ball field touch each other and the paddles, whose
+      // moves may still be running on core 1
+      struct draw_box box = draw_box_of_move(cmd);
+      draw_batch_order(&batch, box);
+      if (cmd->move.radius) {
+        // A ball is a few short spans, cheaper drawn here than queued
+        raster_move_round_rect(&target, cmd->move.x_old, cmd->move.y_old,
+                               cmd->x, cmd->y, cmd->w, cmd->h,
+                               cmd->move.radius, cmd->color);
+      } else {
+        jobs_move_rect(&batch.jobs, canvas, cmd->move.x_old, cmd->move.y_old,
+                       cmd->x, cmd->y, cmd->w, cmd->h, cmd->color);
+        draw_batch_queued(&batch, box);
+      }
+      break;
+    }
+    case DRAW_NET:
+      raster_dashed_vline(&target, cmd->x, cmd->y, cmd->w, cmd->h,
+                          cmd->net.dash, cmd->net.gap, cmd->color);
+      break;
+    case DRAW_TEXT:
+      draw_glyphs(cmd, canvas);
+      break;
+    case DRAW_FADE:
+      vga_fade_rectangle(canvas, cmd->x, cmd->y, cmd->w, cmd->h, cmd->color,
+                         cmd->alpha);
+      break;
+    case DRAW_CLEAR:
+      vga_clear_canvas(canvas);
+      break;
+    case DRAW_SPRITE:
+      sprite_draw(&target, cmd->sprite, cmd->x, cmd->y);
+      break;
+    case DRAW_VIEW:
+      vga_set_view(&(struct vga_view){
+          .scroll = cmd->x,
+          .split = cmd->view.split,
+          .split_scroll = cmd->view.split_scroll,
+          .shake = cmd->view.shake,
+      });
+      break;
+    case DRAW_BACKGROUND:
+      vga_set_background(&(struct vga_background){
+          .texture = cmd->background.texture,
+          .mode = cmd->background.mode,
+          .horizon = cmd->background.horizon,
+          .u = cmd->x,
+          .v = cmd->y,
+          .angle = cmd->w,
+          .scale = cmd->h,
+      });
+      break;
+    }
+
+    // Scanout gets its turn between commands once no job is in flight, a
+    // job still running would write into rows it is reading. Core 1 drains
+    // the queue while it waits, so that is never long.
+    if (jobs_done(&batch.jobs)) {
+      draw_batch_wait(&batch); // Only forgets the boxes
+      lock->exit();
+      locked = false;
+    }
+  }
+
+  if (locked) {
+    draw_batch_wait(&batch);
+    lock->exit();
+  }
+}
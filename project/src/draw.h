@@ -0,0 +1,176 @@
+#ifndef _DRAW_H_
+#define _DRAW_H_
+
+#include <hardware/sync.h>
+#include <pico.h>
+
+#include "game.h"
+#include "sprite.h"
+
+struct vga_background;
+struct vga_texture;
+
+// Per-frame list of drawing commands. The game fills one from the logic task
+// and the draw task replays it onto the canvas, so only the draw task ever
+// touches pixels. Lists change hands through a draw_queue with a pointer
+// swap, and neither side blocks the other for longer than that.
+
+#define DRAW_LIST_SIZE 128 // Commands per list
+#define DRAW_MAX_IDS GAME_MAX_ENTITIES // Objects that can be moved
+#define DRAW_TEXT_MAX 8    // Characters per text command
+
+// 3x5 glyphs for 0-9 and A-Z, lower case is drawn as upper case
+#define DRAW_GLYPH_W 3
+#define DRAW_GLYPH_H 5
+#define DRAW_GLYPH_ADVANCE (DRAW_GLYPH_W + 1)
+
+enum draw_op {
+  DRAW_FILL,       // Solid rectangle
+  DRAW_MOVE,       // Rectangle erased at its old place and drawn at the new one
+  DRAW_NET,        // Dashed vertical line
+  DRAW_FADE,       // Rectangle moved part of the way toward a colour
+  DRAW_TEXT,       // Opaque text on black
+  DRAW_CLEAR,      // Whole canvas to black
+  DRAW_VIEW,       // Scroll, split or shake the screen, see struct vga_view
+  DRAW_SPRITE,     // Opaque pixels of a sprite, see sprite.h
+  DRAW_BACKGROUND, // Move the layer behind the canvas, see vga.h
+};
+
+struct draw_cmd {
+  uint8_t op;
+  uint16_t color;
+
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+
+  union {
+    struct {
+      uint16_t x_old;
+      uint16_t y_old;
+      uint8_t radius; // Rounded corners, 0 for a plain rectangle
+    } move;
+    struct {
+      uint8_t dash;
+      uint8_t gap;
+    } net;
+    uint8_t alpha; // Fade, out of BLEND_ALPHA_MAX
+    char text[DRAW_TEXT_MAX]; // Not terminated when full
+    struct {
+      uint16_t split;
+      uint16_t split_scroll;
+      int16_t shake;
+    } view; // x holds the scroll
+    const struct sprite *sprite;
+    struct {
+      const struct vga_texture *texture;
+      uint16_t horizon;
+      uint8_t mode;
+    } background; // x and y hold u and v, w the angle and h the scale
+  };
+};
+
+struct draw_list {
+  uint16_t count;
+  struct draw_cmd cmds[DRAW_LIST_SIZE];
+
+  // Index + 1 of the pending move per object, so later moves of the same
+  // object update it instead of adding another erase and draw
+  uint16_t move_slot[DRAW_MAX_IDS];
+
+  // Commands were dropped because the list was full. The canvas is cleared
+  // instead and the game has to draw everything again.
+  bool lost;
+
+  // Holds the simulation step the latency probe is following, see latency.h
+  bool latency_probe;
+};
+
+// -------- Recording --------
+
+void draw_list_reset(struct draw_list *list);
+
+// Skipped if an identical fill is already in the list with nothing drawn
+// over its place since
+void draw_fill(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+               uint16_t h, uint16_t color);
+void draw_move(struct draw_list *list, uint16_t id, uint16_t x_old,
+               uint16_t y_old, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+               uint16_t color);
+// Same as draw_move() with the corners rounded, r = w / 2 of a square
+// object draws a disc
+void draw_move_round(struct draw_list *list, uint16_t id, uint16_t x_old,
+                     uint16_t y_old, uint16_t x, uint16_t y, uint16_t w,
+                     uint16_t h, uint8_t radius, uint16_t color);
+// Skipped like an identical draw_fill()
+void draw_net(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+              uint16_t h, uint8_t dash, uint8_t gap, uint16_t color);
+void draw_text(struct draw_list *list, uint16_t x, uint16_t y,
+               const char *text, uint16_t color);
+// Translucent rectangle over whatever was drawn before it
+void draw_fade(struct draw_list *list, uint16_t x, uint16_t y, uint16_t w,
+               uint16_t h, uint16_t color, uint8_t alpha);
+
+// Only the opaque pixels, erase with draw_fill() over sprite->width and
+// sprite->height
+void draw_sprite(struct draw_list *list, uint16_t x, uint16_t y,
+                 const struct sprite *sprite);
+
+// Drops everything recorded before it except the view and the background,
+// none of it would survive the clear
+void draw_clear(struct draw_list *list);
+
+// Moves the visible window over the canvas, the pixels stay where they are
+void draw_view(struct draw_list *list, uint16_t scroll, uint16_t split,
+               uint16_t split_scroll, int16_t shake);
+
+// Sets the textured layer behind the canvas, scanout redraws it every frame
+void draw_background(struct draw_list *list,
+                     const struct vga_background *background);
+
+// The pending move of object `id`, or NULL if it has not moved
+const struct draw_cmd *draw_find_move(const struct draw_list *list,
+                                      uint16_t id);
+
+// -------- Recording --------
+
+// -------- Handover --------
+
+struct draw_queue {
+  struct draw_list lists[3];
+
+  struct draw_list *writer;  // Being recorded by the logic task
+  struct draw_list *pending; // Published, waiting for the draw task
+  struct draw_list *reader;  // Being replayed by the draw task
+
+  spin_lock_t *lock;
+};
+
+void draw_queue_init(struct draw_queue *queue);
+
+struct draw_list *draw_queue_writer(struct draw_queue *queue);
+
+// Hands the recorded list over if the draw task took the previous one,
+// otherwise the writer keeps recording into the same list
+void draw_queue_publish(struct draw_queue *queue);
+
+// The oldest published list, or NULL if nothing new has been drawn. The
+// list stays valid until the next call.
+struct draw_list *draw_queue_take(struct draw_queue *queue);
+
+// -------- Handover --------
+
+// The canvas lock, shared with scanout on core 1
+struct draw_lock {
+  void (*enter)(void);
+  void (*exit)(void);
+};
+
+// Replays a list onto the canvas in one pass, sharing the rectangle work
+// with core 1. The lock is taken per command, or per batch of jobs while
+// some are in flight, so scanout never waits for the whole list.
+void draw_execute(const struct draw_list *list, uint16_t *canvas,
+                  const struct draw_lock *lock);
+
+#endif
@@ -0,0 +1,48 @@
+#include <string.h>
+
+#include "frame.h"
+
+static uint8_t frame_checksum(const struct frame_format *format,
+                              const uint8_t *frame) {
+  uint8_t checksum = 0;
+  for (uint i = 1; i < format->size - 1u; i++) {
+    checksum ^= frame[i];
+  }
+  return checksum;
+}
+
+static bool frame_valid(const struct frame_format *format,
+                        const uint8_t *frame) {
+  return frame[0] == format->sync &&
+         frame[format->size - 1] == frame_checksum(format, frame) &&
+         (!format->valid || format->valid(frame));
+}
+
+void frame_seal(const struct frame_format *format, uint8_t *frame) {
+  frame[0] = format->sync;
+  frame[format->size - 1] = frame_checksum(format, frame);
+}
+
+bool frame_decode(const struct frame_format *format, uint8_t *buf,
+                  uint8_t *used, uint8_t byte) {
+  if (*used == 0 && byte != format->sync) {
+    return false;
+  }
+
+  buf[(*used)++] = byte;
+  if (*used < format->size) {
+    return false;
+  }
+
+  *used = 0;
+  if (!frame_valid(format, buf)) {
+    // Start over from the next sync byte already received, if any
+    uint8_t *sync = memchr(&buf[1], format->sync, format->size - 1u);
+    if (sync) {
+      *used = (uint8_t)(&buf[format->size] - sync);
+      memmove(buf, sync, *used);
+    }
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,32 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <pico.h>
+
+// Fixed-size byte frames, the framing shared by the control protocol and the
+// lockstep link:
+//
+// sync | payload | checksum
+//
+// The checksum is the XOR of the bytes between the sync and itself. Bytes
+// that do not start a valid frame are skipped one at a time, so a decoder
+// finds its way back after noise or a lost byte.
+
+struct frame_format {
+  uint8_t sync;
+  uint8_t size; // Whole frame, sync and checksum included
+  // Checks the payload on top of the checksum, NULL if any payload goes. A
+  // frame it refuses is skipped like a corrupt one.
+  bool (*valid)(const uint8_t *frame);
+};
+
+// Sets the sync byte and the checksum around a payload already in frame[1..]
+void frame_seal(const struct frame_format *format, uint8_t *frame);
+
+// Feeds one received byte into buf, which has room for format->size bytes
+// and holds *used of them. Returns true when it completed a valid frame,
+// which is then in buf until the next call.
+bool frame_decode(const struct frame_format *format, uint8_t *buf,
+                  uint8_t *used, uint8_t byte);
+
+#endif
@@ -1,87 +1,249 @@
 #include "game.h"
 
-void update_paddle_position(pong_rect *paddle, int move_direction,
-                            uint16_t padding_y, uint16_t canvas_h) {
+void update_paddle_position(struct entity_store *es, uint16_t paddle,
+                            int move_direction, uint16_t padding_y,
+                            uint16_t canvas_h) {
   // Move the paddle based on the input direction
-  paddle->y_old = paddle->y;
-  paddle->y += move_direction;
+  es->y_old[paddle] = es->y[paddle];
+  es->y[paddle] += move_direction;
 
   // Bounds checking to keep the paddle within the canvas
-  if (paddle->y < padding_y) {
-    paddle->y = padding_y; // Ensure paddle stays within upper bound
-  } else if (paddle->y + paddle->h > canvas_h - padding_y) {
-    paddle->y = canvas_h - paddle->h - padding_y; // Lower bound
+  if (es->y[paddle] < padding_y) {
+    es->y[paddle] = padding_y; // Ensure paddle stays within upper bound
+  } else if (es->y[paddle] + es->h[paddle] > canvas_h - padding_y) {
+    es->y[paddle] = canvas_h - es->h[paddle] - padding_y; // Lower bound
   }
 }
 
-void gs_update_ball(struct game_state *gs) {
-  // Update ball position
-  gs->ball.x_old = gs->ball.x;
-  gs->ball.y_old = gs->ball.y;
-
-  gs->ball.x += gs->ball.v_x;
-  gs->ball.y += gs->ball.v_y;
-
-  // Check horizontal bounds
-  if (gs->ball.x + gs->ball.w > gs->canvas_w - gs->padding_x) {
-    gs_reset_ball(gs);
-    gs->player_score++;
-  } else if (gs->ball.x < gs->padding_x) {
-    gs_reset_ball(gs);
-    gs->ai_score++;
+void gs_add_entity(struct game_state *gs, const pong_rect *rect) {
+  struct entity_store *es = &gs->entities;
+  if (es->count >= GAME_MAX_ENTITIES) {
+    return;
   }
 
-  // Check vertical bounds
-  if (gs->ball.y + gs->ball.h > gs->canvas_h - gs->padding_y) {
-    gs->ball.y = gs->canvas_h - gs->ball.h - gs->padding_y;
-    gs->ball.v_y *= -1; // Reverse velocity
-  } else if (gs->ball.y < gs->padding_y) {
-    gs->ball.y = gs->padding_y;
-    gs->ball.v_y *= -1; // Reverse velocity
+  uint16_t i = es->count++;
+  es->x[i] = rect->x;
+  es->y[i] = rect->y;
+  es->x_old[i] = rect->x_old;
+  es->y_old[i] = rect->y_old;
+  es->v_x[i] = (int16_t)rect->v_x;
+  es->v_y[i] = (int16_t)rect->v_y;
+  es->w[i] = (uint8_t)rect->w;
+  es->h[i] = (uint8_t)rect->h;
+  es->color[i] = rect->color;
+}
+
+// Grows or shrinks the ball set, new balls copy the look of the first one
+void gs_set_ball_count(struct game_state *gs, uint16_t count) {
+  struct entity_store *es = &gs->entities;
+  if (count < 1) {
+    count = 1;
+  } else if (count > GAME_MAX_BALLS) {
+    count = GAME_MAX_BALLS;
   }
 
-  // Check collision with player paddle
-  if (gs->ball.x < gs->player.x + gs->player.w &&
-      gs->ball.x + gs->ball.w > gs->player.x &&
-      gs->ball.y < gs->player.y + gs->player.h &&
-      gs->ball.y + gs->ball.h > gs->player.y) {
-    gs->ball.x = gs->player.x + gs->player.w; // Place ball at paddle edge
-    gs->ball.v_x *= -1;                       // Reverse velocity
+  uint16_t old_count = es->count;
+  es->count = GAME_ENTITY_BALL + count;
+  gs->events |= GS_EVENT_RESET;
+
+  for (uint16_t i = old_count; i < es->count; i++) {
+    es->w[i] = es->w[GAME_ENTITY_BALL];
+    es->h[i] = es->h[GAME_ENTITY_BALL];
+    es->color[i] = es->color[GAME_ENTITY_BALL];
+    gs_reset_ball(gs, i);
+    es->x_old[i] = es->x[i];
+    es->y_old[i] = es->y[i];
   }
+}
+
+void gs_update_ball(struct game_state *gs) {
+  struct entity_store *es = &gs->entities;
+
+  const uint16_t top = gs->padding_y;
+  const uint16_t left = gs->padding_x;
+
+  const uint16_t player_x = es->x[GAME_ENTITY_PLAYER];
+  const uint16_t player_y = es->y[GAME_ENTITY_PLAYER];
+  const uint16_t player_w = es->w[GAME_ENTITY_PLAYER];
+  const uint16_t player_h = es->h[GAME_ENTITY_PLAYER];
+
+  const uint16_t ai_x = es->x[GAME_ENTITY_AI];
+  const uint16_t ai_y = es->y[GAME_ENTITY_AI];
+  const uint16_t ai_w = es->w[GAME_ENTITY_AI];
+  const uint16_t ai_h = es->h[GAME_ENTITY_AI];
+
+  gs->events = 0;
+
+  for (uint16_t i = GAME_ENTITY_BALL; i < es->count; i++) {
+    // Update ball position
+    es->x_old[i] = es->x[i];
+    es->y_old[i] = es->y[i];
 
-  // Check collision with AI paddle
-  if (gs->ball.x < gs->ai.x + gs->ai.w && gs->ball.x + gs->ball.w > gs->ai.x &&
-      gs->ball.y < gs->ai.y + gs->ai.h && gs->ball.y + gs->ball.h > gs->ai.y) {
-    gs->ball.x = gs->ai.x - gs->ball.w; // Place ball at paddle edge
-    gs->ball.v_x *= -1;                 // Reverse velocity
+    es->x[i] += es->v_x[i];
+    es->y[i] += es->v_y[i];
+
+    const uint16_t right = gs->canvas_w - gs->padding_x - es->w[i];
+    const uint16_t bottom = gs->canvas_h - gs->padding_y - es->h[i];
+
+    // Check horizontal bounds
+    if (es->x[i] > right) {
+      gs_reset_ball(gs, i);
+      gs->player_score++;
+      gs->events |= GS_EVENT_SCORE;
+    } else if (es->x[i] < left) {
+      gs_reset_ball(gs, i);
+      gs->ai_score++;
+      gs->events |= GS_EVENT_SCORE;
+    }
+
+    // Check vertical bounds
+    if (es->y[i] > bottom) {
+      es->y[i] = bottom;
+      es->v_y[i] = -es->v_y[i]; // Reverse velocity
+      gs->events |= GS_EVENT_WALL;
+    } else if (es->y[i] < top) {
+      es->y[i] = top;
+      es->v_y[i] = -es->v_y[i]; // Reverse velocity
+      gs->events |= GS_EVENT_WALL;
+    }
+
+    // Check collision with player paddle
+    if (es->x[i] < player_x + player_w && es->x[i] + es->w[i] > player_x &&
+        es->y[i] < player_y + player_h && es->y[i] + es->h[i] > player_y) {
+      es->x[i] = player_x + player_w; // Place ball at paddle edge
+      es->v_x[i] = -es->v_x[i];       // Reverse velocity
+      gs->events |= GS_EVENT_PADDLE;
+    }
+
+    // Check collision with AI paddle
+    if (es->x[i] < ai_x + ai_w && es->x[i] + es->w[i] > ai_x &&
+        es->y[i] < ai_y + ai_h && es->y[i] + es->h[i] > ai_y) {
+      es->x[i] = ai_x - es->w[i]; // Place ball at paddle edge
+      es->v_x[i] = -es->v_x[i];   // Reverse velocity
+      gs->events |= GS_EVENT_PADDLE;
+    }
   }
 }
 
 void gs_update_player(struct game_state *gs, int move_direction) {
+  struct entity_store *es = &gs->entities;
+
   // Move the player paddle
-  update_paddle_position(&gs->player, move_direction * gs->player.v_y,
+  update_paddle_position(es, GAME_ENTITY_PLAYER,
+                         move_direction * es->v_y[GAME_ENTITY_PLAYER],
                          gs->padding_y, gs->canvas_h);
 }
 
 void gs_update_ai(struct game_state *gs) {
-  // Determine AI paddle movement
-  int move_direction = 0;
-  if (gs->ball.y < gs->ai.y) {
-    move_direction = -1; // Move paddle up
-  } else if (gs->ball.y > gs->ai.y + gs->ai.h) {
-    move_direction = 1; // Move paddle up; // Move paddle down
-  }
+  struct entity_store *es = &gs->entities;
+
+  // The AI only re-solves the ball trajectory on bounces and resets
+  int move_direction = ai_update(gs);
 
   // Move the AI paddle
-  update_paddle_position(&gs->ai, move_direction * gs->ai.v_y, gs->padding_y,
-                         gs->canvas_h);
+  update_paddle_position(es, GAME_ENTITY_AI,
+                         move_direction * es->v_y[GAME_ENTITY_AI],
+                         gs->padding_y, gs->canvas_h);
 }
 
 // function that calculates if the ball is going to hit the left or right wall
-// and resets the game and the ball spwaning at the center
-void gs_reset_ball(struct game_state *gs) {
-  gs->ball.x = gs->canvas_w / 2;
-  gs->ball.y = gs->canvas_h / 2;
-  gs->ball.v_x = 2;
-  gs->ball.v_y = 2;
+// and resets the game and the ball spwaning at the center. Every ball gets its
+// own launch direction so a multi-ball field fans out instead of overlapping.
+void gs_reset_ball(struct game_state *gs, uint16_t ball) {
+  struct entity_store *es = &gs->entities;
+  uint16_t n = ball - GAME_ENTITY_BALL;
+
+  int16_t speed_y = (int16_t)(1 + (n + 1) % 3);
+
+  es->x[ball] = gs->canvas_w / 2;
+  es->y[ball] = gs->canvas_h / 2;
+  es->v_x[ball] = (n & 1) ? -2 : 2;
+  es->v_y[ball] = ((n >> 1) & 1) ? -speed_y : speed_y;
+}
+
+static int apply_input(struct game_state *gs, uint8_t input) {
+  switch (input) {
+  case GS_INPUT_UP:
+    return -1;
+  case GS_INPUT_DOWN:
+    return 1;
+  case GS_INPUT_SINGLE_BALL:
+  case GS_INPUT_MULTI_BALL:
+    gs_set_ball_count(gs, input == GS_INPUT_SINGLE_BALL ? 1
+                                                         : GAME_MULTIBALL_COUNT);
+    gs->reset_score = true; // Wipe balls that no longer exist
+    return 0;
+  case GS_INPUT_AI_EASY:
+    ai_set_difficulty(&gs->ai, AI_DIFFICULTY_EASY);
+    return 0;
+  case GS_INPUT_AI_NORMAL:
+    ai_set_difficulty(&gs->ai, AI_DIFFICULTY_NORMAL);
+    return 0;
+  case GS_INPUT_AI_HARD:
+    ai_set_difficulty(&gs->ai, AI_DIFFICULTY_HARD);
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+static void check_winner(struct game_state *gs) {
+  if (gs->player_score >= GAME_WINNING_SCORE ||
+      gs->ai_score >= GAME_WINNING_SCORE) {
+    gs->reset_score = true;
+    gs->player_score = 0;
+    gs->ai_score = 0;
+  }
+}
+
+void gs_tick(struct game_state *gs, uint8_t input) {
+  int move_direction = apply_input(gs, input);
+
+  gs_update_player(gs, move_direction);
+  gs_update_ai(gs);
+  gs_update_ball(gs);
+  check_winner(gs);
+}
+
+void gs_tick_versus(struct game_state *gs, uint8_t left_input,
+                    uint8_t right_input) {
+  struct entity_store *es = &gs->entities;
+  int left = apply_input(gs, left_input);
+  int right = apply_input(gs, right_input);
+
+  gs_update_player(gs, left);
+  update_paddle_position(es, GAME_ENTITY_AI,
+                         right * es->v_y[GAME_ENTITY_PLAYER], gs->padding_y,
+                         gs->canvas_h);
+  gs_update_ball(gs);
+  check_winner(gs);
+}
+
+// FNV-1a, fed one value at a time so padding and endianness never matter
+static uint32_t hash_u32(uint32_t hash, uint32_t value, uint bytes) {
+  for (uint i = 0; i < bytes; i++) {
+    hash ^= (value >> (8 * i)) & 0xff;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint32_t gs_hash(const struct game_state *gs) {
+  const struct entity_store *es = &gs->entities;
+  uint32_t hash = 2166136261u;
+
+  hash = hash_u32(hash, es->count, 2);
+  for (uint16_t i = 0; i < es->count; i++) {
+    hash = hash_u32(hash, es->x[i], 2);
+    hash = hash_u32(hash, es->y[i], 2);
+    hash = hash_u32(hash, (uint16_t)es->v_x[i], 2);
+    hash = hash_u32(hash, (uint16_t)es->v_y[i], 2);
+  }
+
+  hash = hash_u32(hash, gs->player_score, 2);
+  hash = hash_u32(hash, gs->ai_score, 2);
+  hash = hash_u32(hash, gs->ai.target_y, 2);
+  hash = hash_u32(hash, gs->ai.delay, 1);
+  hash = hash_u32(hash, gs->ai.rng, 4);
+  return hash;
 }
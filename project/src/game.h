@@ -3,6 +3,50 @@
 
 #include <pico.h>
 
+#include "ai.h"
+
+// -------- Entities --------
+
+#define GAME_ENTITY_PLAYER 0
+#define GAME_ENTITY_AI 1
+#define GAME_ENTITY_BALL 2 // First ball, every entity after it is a ball too
+
+// Every ball is a command in each Pong draw list, pong.c checks the two
+// agree. The host entity bench builds with more.
+#ifndef GAME_MAX_BALLS
+#define GAME_MAX_BALLS 96
+#endif
+#define GAME_MAX_ENTITIES (GAME_ENTITY_BALL + GAME_MAX_BALLS)
+
+#define GAME_WINNING_SCORE 6
+#define GAME_MULTIBALL_COUNT 64 // Balls spawned by the multi-ball mode
+
+// -------- Entities --------
+
+// -------- Events --------
+
+#define GS_EVENT_WALL (1u << 0)   // A ball bounced off the top or bottom wall
+#define GS_EVENT_PADDLE (1u << 1) // A ball bounced off a paddle
+#define GS_EVENT_SCORE (1u << 2)  // A ball left the court and was reset
+#define GS_EVENT_RESET (1u << 3)  // Balls were added or removed
+
+// -------- Events --------
+
+// -------- Inputs --------
+
+// Everything that can change the simulation from outside, one per tick
+#define GS_INPUT_NONE 0
+#define GS_INPUT_UP 1
+#define GS_INPUT_DOWN 2
+#define GS_INPUT_SINGLE_BALL 3
+#define GS_INPUT_MULTI_BALL 4
+#define GS_INPUT_AI_EASY 5
+#define GS_INPUT_AI_NORMAL 6
+#define GS_INPUT_AI_HARD 7
+#define GS_INPUT_COUNT 8
+
+// -------- Inputs --------
+
 typedef struct pong_rect {
   uint16_t x;
   uint16_t y;
@@ -19,6 +63,26 @@ typedef struct pong_rect {
   uint16_t color;
 } pong_rect;
 
+// Structure-of-arrays store for everything that moves. The update loops walk
+// each array linearly, so adding balls only grows the arrays being streamed.
+struct entity_store {
+  uint16_t count;
+
+  uint16_t x[GAME_MAX_ENTITIES];
+  uint16_t y[GAME_MAX_ENTITIES];
+
+  uint16_t x_old[GAME_MAX_ENTITIES];
+  uint16_t y_old[GAME_MAX_ENTITIES];
+
+  int16_t v_x[GAME_MAX_ENTITIES];
+  int16_t v_y[GAME_MAX_ENTITIES];
+
+  uint8_t w[GAME_MAX_ENTITIES];
+  uint8_t h[GAME_MAX_ENTITIES];
+
+  uint16_t color[GAME_MAX_ENTITIES];
+};
+
 struct game_state {
   uint16_t bg_color;
 
@@ -28,11 +92,11 @@ struct game_state {
   uint16_t canvas_w;
   uint16_t canvas_h;
 
-  pong_rect ball;
-  pong_rect player;
-  pong_rect ai;
-  
-  
+  struct entity_store entities;
+  struct ai_state ai;
+
+  uint8_t events; // GS_EVENT_* raised since the last gs_update_ball()
+
   pong_rect draw_point_player;
   pong_rect draw_point_ai;
 
@@ -42,10 +106,26 @@ struct game_state {
   bool reset_score;
 };
 
+void gs_add_entity(struct game_state *gs, const pong_rect *rect);
+void gs_set_ball_count(struct game_state *gs, uint16_t count);
+
 void gs_update_player(struct game_state *gs, int move_direction);
 void gs_update_ball(struct game_state *gs);
 void gs_update_ai(struct game_state *gs);
-void gs_reset_ball(struct game_state *gs);
+void gs_reset_ball(struct game_state *gs, uint16_t ball);
+
+// One full simulation step: the GS_INPUT_* for this tick, player, AI, balls
+// and the score reset. Nothing else may change the state if replays and
+// lockstep are to stay deterministic.
+void gs_tick(struct game_state *gs, uint8_t input);
+
+// Lockstep versus step: the right paddle follows `right_input` at the
+// player's speed instead of the AI. Both boards run it with the same pair of
+// inputs, the same rules as gs_tick() apply.
+void gs_tick_versus(struct game_state *gs, uint8_t left_input,
+                    uint8_t right_input);
 
+// Platform independent digest of everything the simulation depends on
+uint32_t gs_hash(const struct game_state *gs);
 
 #endif
@@ -0,0 +1,144 @@
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+
+#include "jobs.h"
+#include "vga.h"
+
+enum job_kind {
+  JOB_FILL,
+  JOB_MOVE,
+};
+
+struct job {
+  struct jobs_batch *batch;
+  uint16_t *canvas;
+
+  uint16_t x_old;
+  uint16_t y_old;
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+
+  uint16_t color;
+  uint8_t kind;
+};
+
+// The Cortex-M0+ has no exclusive loads, so a hardware spinlock guards the
+// few instructions that move the indices. Jobs themselves run unlocked.
+static spin_lock_t *queue_lock;
+static struct job queue[JOBS_QUEUE_SIZE];
+static uint16_t head; // Next slot to fill
+static uint16_t tail; // Next slot to run
+
+void jobs_init(void) {
+  queue_lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+static void __not_in_flash_func(job_run)(const struct job *job) {
+  switch (job->kind) {
+  case JOB_FILL:
+    vga_fill_rectangle(job->canvas, job->x, job->y, job->w, job->h,
+                       job->color);
+    break;
+  case JOB_MOVE:
+    vga_move_rectangle(job->canvas, job->x_old, job->y_old, job->x, job->y,
+                       job->w, job->h, job->color);
+    break;
+  }
+}
+
+static void __not_in_flash_func(job_done)(struct jobs_batch *batch) {
+  uint32_t irq = spin_lock_blocking(queue_lock);
+  batch->pending--;
+  spin_unlock(queue_lock, irq);
+}
+
+// Queues a job, or runs it right away if the queue is full
+static void job_submit(const struct job *job) {
+  uint32_t irq = spin_lock_blocking(queue_lock);
+  bool queued = (uint16_t)(head - tail) < JOBS_QUEUE_SIZE;
+  if (queued) {
+    queue[head++ & (JOBS_QUEUE_SIZE - 1)] = *job;
+    job->batch->pending++;
+  }
+  spin_unlock(queue_lock, irq);
+
+  if (!queued) {
+    job_run(job);
+  }
+}
+
+bool __not_in_flash_func(jobs_run_one)(void) {
+  struct job job;
+
+  uint32_t irq = spin_lock_blocking(queue_lock);
+  bool found = head != tail;
+  if (found) {
+    job = queue[tail++ & (JOBS_QUEUE_SIZE - 1)];
+  }
+  spin_unlock(queue_lock, irq);
+
+  if (found) {
+    job_run(&job);
+    job_done(job.batch);
+  }
+  return found;
+}
+
+void jobs_fill_rect(struct jobs_batch *batch, uint16_t *canvas, size_t x,
+                    size_t y, size_t width, size_t height, uint16_t color) {
+  struct job job = {
+      .batch = batch,
+      .canvas = canvas,
+      .x = (uint16_t)x,
+      .w = (uint16_t)width,
+      .color = color,
+      .kind = JOB_FILL,
+  };
+
+  if (width * height < JOBS_SPLIT_MIN_PIXELS) {
+    job.y = (uint16_t)y;
+    job.h = (uint16_t)height;
+    job_submit(&job);
+    return;
+  }
+
+  // Row bands never share a pixel, so they can run on both cores at once
+  for (size_t band = 0; band < height; band += JOBS_BAND_ROWS) {
+    job.y = (uint16_t)(y + band);
+    job.h = (uint16_t)MIN(JOBS_BAND_ROWS, height - band);
+    job_submit(&job);
+  }
+}
+
+void jobs_move_rect(struct jobs_batch *batch, uint16_t *canvas, size_t x_old,
+                    size_t y_old, size_t x, size_t y, size_t width,
+                    size_t height, uint16_t color) {
+  struct job job = {
+      .batch = batch,
+      .canvas = canvas,
+      .x_old = (uint16_t)x_old,
+      .y_old = (uint16_t)y_old,
+      .x = (uint16_t)x,
+      .y = (uint16_t)y,
+      .w = (uint16_t)width,
+      .h = (uint16_t)height,
+      .color = color,
+      .kind = JOB_MOVE,
+  };
+  job_submit(&job);
+}
+
+bool __not_in_flash_func(jobs_done)(const struct jobs_batch *batch) {
+  return __atomic_load_n(&batch->pending, __ATOMIC_ACQUIRE) == 0;
+}
+
+void jobs_wait(struct jobs_batch *batch) {
+  while (batch->pending) {
+    // The last jobs may be running on the other core, keep polling
+    if (!jobs_run_one()) {
+      tight_loop_contents();
+    }
+  }
+}
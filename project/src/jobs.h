@@ -0,0 +1,43 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <pico.h>
+
+// Drawing work shared between both cores. Whoever holds the canvas lock
+// queues jobs and then helps drain them in jobs_wait(), while the render task
+// on core 1 picks jobs up whenever it would otherwise sit idle. Jobs in one
+// batch may run in any order on either core, so only queue work that does not
+// overlap and jobs_wait() between dependent steps.
+
+#define JOBS_QUEUE_SIZE 64 // Must be a power of two
+#define JOBS_BAND_ROWS 16  // Rows per job when a fill is split up
+
+// Fills smaller than this run inline, a job costs more than it saves
+#define JOBS_SPLIT_MIN_PIXELS 1024
+
+struct jobs_batch {
+  volatile uint16_t pending; // Queued or running jobs of this batch
+};
+
+void jobs_init(void);
+
+// -------- Producers --------
+
+void jobs_fill_rect(struct jobs_batch *batch, uint16_t *canvas, size_t x,
+                    size_t y, size_t width, size_t height, uint16_t color);
+void jobs_move_rect(struct jobs_batch *batch, uint16_t *canvas, size_t x_old,
+                    size_t y_old, size_t x, size_t y, size_t width,
+                    size_t height, uint16_t color);
+
+// Runs queued jobs until every job of the batch has finished
+void jobs_wait(struct jobs_batch *batch);
+
+// Whether every job of the batch has finished, never waits
+bool jobs_done(const struct jobs_batch *batch);
+
+// -------- Producers --------
+
+// Runs one queued job from any batch, false if the queue was empty
+bool jobs_run_one(void);
+
+#endif
@@ -0,0 +1,235 @@
+#include <utility>
+
+#include "kernels.h"
+
+namespace {
+
+// Template argument for a size only known at run time
+constexpr int kAny = 0;
+
+// Widths worth an instance of their own: Pong's paddles and ball, Breakout's
+// ball, bricks and paddle
+#define KERNEL_WIDTHS(X) X(5) X(6) X(10) X(28) X(40)
+
+// Two 16-bit pixels stored at once. The row is uint16_t, so the word access
+// has to be allowed to alias it.
+typedef uint32_t __attribute__((may_alias)) kernel_pair;
+
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+// -------- Rows --------
+
+template <typename Pixel, int... I>
+KERNEL_INLINE void store_each(Pixel *dest, Pixel value,
+                              std::integer_sequence<int, I...>) {
+  ((dest[I] = value), ...);
+}
+
+// Spelled out for kernel_pair, a deduced template argument would lose the
+// may_alias attribute
+template <int... I>
+KERNEL_INLINE void store_pairs(kernel_pair *dest, uint32_t pair,
+                               std::integer_sequence<int, I...>) {
+  ((dest[I] = pair), ...);
+}
+
+// N pixels from a word aligned dest, in pairs and one more if N is odd
+template <int N>
+KERNEL_INLINE void fill_pairs(uint16_t *dest, uint16_t color) {
+  uint32_t pair = color * 0x00010001u;
+  store_pairs(reinterpret_cast<kernel_pair *>(dest), pair,
+              std::make_integer_sequence<int, N / 2>{});
+  if constexpr (N % 2) {
+    dest[N - 1] = color;
+  }
+}
+
+// W pixels of a row. A known W is nothing but stores, kAny loops over count.
+template <typename Pixel, int W>
+KERNEL_INLINE void fill_row(Pixel *dest, int count, Pixel color) {
+  if constexpr (W == kAny) {
+    for (int i = 0; i < count; i++) {
+      dest[i] = color;
+    }
+  } else if constexpr (sizeof(Pixel) == 2 && W >= 3) {
+    // Rows start word aligned, so x alone decides and the branch goes the
+    // same way for every row of a rectangle
+    if (reinterpret_cast<uintptr_t>(dest) & 2) {
+      dest[0] = color;
+      fill_pairs<W - 1>(dest + 1, color);
+    } else {
+      fill_pairs<W>(dest, color);
+    }
+  } else {
+    store_each(dest, color, std::make_integer_sequence<int, W>{});
+  }
+}
+
+template <typename Pixel>
+KERNEL_INLINE Pixel *target_row(const struct raster_target *target, int y) {
+  return reinterpret_cast<Pixel *>(target->row(target->canvas, (size_t)y));
+}
+
+// -------- Rows --------
+
+// -------- Rectangles --------
+
+// Canvas size of the instance, constants unless it is kAny
+template <int CanvasW>
+KERNEL_INLINE int canvas_w(const struct raster_target *target) {
+  return CanvasW == kAny ? target->width : CanvasW;
+}
+template <int CanvasH>
+KERNEL_INLINE int canvas_h(const struct raster_target *target) {
+  return CanvasH == kAny ? target->height : CanvasH;
+}
+
+// Instances with a known W are only picked for rectangles whose columns all
+// lie on the canvas, so they clip rows only
+template <typename Pixel, int CanvasW, int CanvasH, int W>
+KERNEL_INLINE void fill_rect(const struct raster_target *target, int x, int y,
+                             int w, int h, Pixel color) {
+  int width = canvas_w<CanvasW>(target);
+  int height = canvas_h<CanvasH>(target);
+
+  int y0 = y < 0 ? 0 : y;
+  int y1 = y + h > height ? height : y + h;
+  if constexpr (W == kAny) {
+    if (x < 0) {
+      w += x;
+      x = 0;
+    }
+    if (x + w > width) {
+      w = width - x;
+    }
+    if (w <= 0) {
+      return;
+    }
+  }
+
+  for (int row = y0; row < y1; row++) {
+    fill_row<Pixel, W>(target_row<Pixel>(target, row) + x, w, color);
+  }
+}
+
+// Pixels [x0, x1) of a row, clipped
+template <typename Pixel, int CanvasW>
+KERNEL_INLINE void fill_span(const struct raster_target *target, Pixel *row,
+                             int x0, int x1, Pixel color) {
+  int width = canvas_w<CanvasW>(target);
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 > width ? width : x1;
+  fill_row<Pixel, kAny>(row + x0, x1 - x0, color);
+}
+
+template <typename Pixel, int CanvasW, int CanvasH, int W>
+KERNEL_INLINE void move_rect(const struct raster_target *target, int x_old,
+                             int y_old, int x, int y, int w, int h,
+                             Pixel color) {
+  int height = canvas_h<CanvasH>(target);
+
+  // Old rows the new rectangle misses are erased whole, the rows both share
+  // only left and right of it
+  int y0 = y_old < 0 ? 0 : y_old;
+  int y1 = y_old + h > height ? height : y_old + h;
+  for (int row = y0; row < y1; row++) {
+    Pixel *dest = target_row<Pixel>(target, row);
+    if (row < y || row >= y + h) {
+      if constexpr (W == kAny) {
+        fill_span<Pixel, CanvasW>(target, dest, x_old, x_old + w, 0);
+      } else {
+        fill_row<Pixel, W>(dest + x_old, W, 0);
+      }
+    } else {
+      fill_span<Pixel, CanvasW>(target, dest, x_old,
+                                x_old + w < x ? x_old + w : x, 0);
+      fill_span<Pixel, CanvasW>(target, dest, x_old > x + w ? x_old : x + w,
+                                x_old + w, 0);
+    }
+  }
+
+  fill_rect<Pixel, CanvasW, CanvasH, W>(target, x, y, w, h, color);
+}
+
+// -------- Rectangles --------
+
+// Picks the instance for one rectangle on the specialized canvas
+template <int CanvasW, int CanvasH>
+KERNEL_INLINE void fill_dispatch(const struct raster_target *target, int x,
+                                 int y, int w, int h, uint16_t color) {
+  if (x >= 0 && x + w <= CanvasW) {
+    switch (w) {
+#define KERNEL_FILL_CASE(width)                                                \
+  case width:                                                                  \
+    fill_rect<uint16_t, CanvasW, CanvasH, width>(target, x, y, w, h, color);   \
+    return;
+      KERNEL_WIDTHS(KERNEL_FILL_CASE)
+#undef KERNEL_FILL_CASE
+    }
+  }
+  fill_rect<uint16_t, CanvasW, CanvasH, kAny>(target, x, y, w, h, color);
+}
+
+template <int CanvasW, int CanvasH>
+KERNEL_INLINE void move_dispatch(const struct raster_target *target,
+                                 int x_old, int y_old, int x, int y, int w,
+                                 int h, uint16_t color) {
+  if (x_old >= 0 && x_old + w <= CanvasW && x >= 0 && x + w <= CanvasW) {
+    switch (w) {
+#define KERNEL_MOVE_CASE(width)                                                \
+  case width:                                                                  \
+    move_rect<uint16_t, CanvasW, CanvasH, width>(target, x_old, y_old, x, y,   \
+                                                 w, h, color);                 \
+    return;
+      KERNEL_WIDTHS(KERNEL_MOVE_CASE)
+#undef KERNEL_MOVE_CASE
+    }
+  }
+  move_rect<uint16_t, CanvasW, CanvasH, kAny>(target, x_old, y_old, x, y, w, h,
+                                              color);
+}
+
+KERNEL_INLINE bool target_is_specialized(const struct raster_target *target) {
+  return target->width == KERNEL_CANVAS_W &&
+         target->height == KERNEL_CANVAS_H;
+}
+
+} // namespace
+
+extern "C" {
+
+void __not_in_flash_func(kernel_fill_rect)(const struct raster_target *target,
+                                           int x, int y, int w, int h,
+                                           uint16_t color) {
+  if (target_is_specialized(target)) {
+    fill_dispatch<KERNEL_CANVAS_W, KERNEL_CANVAS_H>(target, x, y, w, h, color);
+  } else {
+    fill_rect<uint16_t, kAny, kAny, kAny>(target, x, y, w, h, color);
+  }
+}
+
+void __not_in_flash_func(kernel_move_rect)(const struct raster_target *target,
+                                           int x_old, int y_old, int x, int y,
+                                           int w, int h, uint16_t color) {
+  if (target_is_specialized(target)) {
+    move_dispatch<KERNEL_CANVAS_W, KERNEL_CANVAS_H>(target, x_old, y_old, x, y,
+                                                    w, h, color);
+  } else {
+    move_rect<uint16_t, kAny, kAny, kAny>(target, x_old, y_old, x, y, w, h,
+                                          color);
+  }
+}
+
+void kernel_fill_rect_generic(const struct raster_target *target, int x,
+                              int y, int w, int h, uint16_t color) {
+  fill_rect<uint16_t, kAny, kAny, kAny>(target, x, y, w, h, color);
+}
+
+void kernel_move_rect_generic(const struct raster_target *target, int x_old,
+                              int y_old, int x, int y, int w, int h,
+                              uint16_t color) {
+  move_rect<uint16_t, kAny, kAny, kAny>(target, x_old, y_old, x, y, w, h,
+                                        color);
+}
+
+} // extern "C"
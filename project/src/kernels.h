@@ -0,0 +1,46 @@
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <pico.h>
+
+#include "raster.h"
+
+// Rectangle fill and move kernels, written as C++17 templates in kernels.cpp
+// and called from C. The templates take the pixel type, the canvas size and
+// the rectangle width as parameters, so the sizes the games draw every frame
+// get inner loops with no bounds left to test: a known width is unrolled into
+// straight stores, two pixels per 32-bit store where the row allows it.
+//
+// Every call picks its instance at run time: the canvas size of the target
+// and the width are compared against the specialized ones, anything else
+// takes the generic instance. Both clip the same way and set the same pixels.
+
+// Canvas size the kernels are specialized for, the 320x240 VGA mode
+#define KERNEL_CANVAS_W 320
+#define KERNEL_CANVAS_H 240
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Solid rectangle, clipped to the target
+void kernel_fill_rect(const struct raster_target *target, int x, int y, int w,
+                      int h, uint16_t color);
+
+// Rectangle erased to black at its old place and drawn at the new one. Only
+// old pixels the new rectangle does not cover are erased.
+void kernel_move_rect(const struct raster_target *target, int x_old,
+                      int y_old, int x, int y, int w, int h, uint16_t color);
+
+// The same with the specialized instances skipped, for comparisons
+void kernel_fill_rect_generic(const struct raster_target *target, int x,
+                              int y, int w, int h, uint16_t color);
+void kernel_move_rect_generic(const struct raster_target *target, int x_old,
+                              int y_old, int x, int y, int w, int h,
+                              uint16_t color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
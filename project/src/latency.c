@@ -0,0 +1,145 @@
+#include <hardware/timer.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+#include "vga.h"
+
+struct latency_sample {
+  uint32_t at[LATENCY_STAGES];
+  uint8_t source; // enum latency_source
+};
+
+// The press being followed. Every stage is stamped by a different context,
+// but only by the one the probe is waiting for, so `next` orders them.
+static struct latency_sample probe;
+static volatile uint8_t next = LATENCY_EDGE; // LATENCY_EDGE = idle
+
+static volatile uint32_t edge_at; // First edge of the last IR frame
+
+volatile uint16_t latency_scanout_line = LATENCY_NO_LINE;
+
+// Finished presses, written by the render core and read by latency_report()
+static struct latency_sample samples[LATENCY_SAMPLES];
+static uint32_t samples_head;
+static uint32_t samples_tail;
+
+static uint32_t histogram[LATENCY_SOURCES][LATENCY_BUCKETS];
+static uint32_t presses[LATENCY_SOURCES];
+static volatile uint32_t last_us[LATENCY_SOURCES];
+
+static const char *const source_names[LATENCY_SOURCES] = {"ir", "usb"};
+
+void __not_in_flash_func(latency_edge)(void) { edge_at = time_us_32(); }
+
+static void latency_start(enum latency_source source, uint32_t edge,
+                          uint32_t now) {
+  uint8_t waiting = next;
+  if (waiting != LATENCY_EDGE &&
+      now - probe.at[LATENCY_EDGE] < LATENCY_TIMEOUT_US) {
+    return; // Still following the previous press
+  }
+
+  // IR and USB presses are started from different tasks, one of them wins.
+  // LATENCY_DECODE is never stamped, so it keeps everyone out meanwhile.
+  if (!__atomic_compare_exchange_n(&next, &waiting, LATENCY_DECODE, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+    return;
+  }
+  latency_scanout_line = LATENCY_NO_LINE;
+
+  probe.at[LATENCY_EDGE] = edge;
+  probe.at[LATENCY_DECODE] = now;
+  probe.source = (uint8_t)source;
+  __atomic_store_n(&next, LATENCY_CONSUME, __ATOMIC_RELEASE);
+}
+
+void latency_decoded(void) {
+  latency_start(LATENCY_IR, edge_at, time_us_32());
+}
+
+void latency_received(void) {
+  uint32_t now = time_us_32();
+  latency_start(LATENCY_USB, now, now);
+}
+
+bool latency_stamp(enum latency_stage stage) {
+  if (__atomic_load_n(&next, __ATOMIC_ACQUIRE) != stage) {
+    return false;
+  }
+
+  probe.at[stage] = time_us_32();
+  __atomic_store_n(&next, (uint8_t)(stage + 1), __ATOMIC_RELEASE);
+  return true;
+}
+
+void latency_drawn(int row) {
+  if (!latency_stamp(LATENCY_DRAW)) {
+    return;
+  }
+
+  int line = row < 0 ? -1 : vga_get_row_line((uint)row);
+  latency_scanout_line = line < 0 ? LATENCY_ANY_LINE : (uint16_t)line;
+}
+
+void __not_in_flash_func(latency_scanned_out)(void) {
+  latency_scanout_line = LATENCY_NO_LINE;
+  if (!latency_stamp(LATENCY_SCANOUT)) {
+    return;
+  }
+
+  uint32_t total_us = probe.at[LATENCY_SCANOUT] - probe.at[LATENCY_EDGE];
+  uint bucket =
+      MIN(total_us / (LATENCY_BUCKET_MS * 1000), LATENCY_BUCKETS - 1);
+  histogram[probe.source][bucket]++;
+  presses[probe.source]++;
+  last_us[probe.source] = total_us;
+
+  // A full queue keeps the older presses, the histogram still counts it
+  if (samples_head - __atomic_load_n(&samples_tail, __ATOMIC_ACQUIRE) <
+      LATENCY_SAMPLES) {
+    samples[samples_head % LATENCY_SAMPLES] = probe;
+    __atomic_store_n(&samples_head, samples_head + 1, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&next, LATENCY_EDGE, __ATOMIC_RELEASE);
+}
+
+void latency_report(uint32_t uptime_ms) {
+  static uint32_t reported[LATENCY_SOURCES];
+
+  uint32_t head = __atomic_load_n(&samples_head, __ATOMIC_ACQUIRE);
+  for (uint32_t tail = samples_tail; tail != head; tail++) {
+    const struct latency_sample *sample = &samples[tail % LATENCY_SAMPLES];
+    const uint32_t *at = sample->at;
+
+    printf("LATENCY,%lu,%s,%lu,%lu,%lu,%lu,%lu,%lu\n", uptime_ms,
+           source_names[sample->source],
+           at[LATENCY_SCANOUT] - at[LATENCY_EDGE],
+           at[LATENCY_DECODE] - at[LATENCY_EDGE],
+           at[LATENCY_CONSUME] - at[LATENCY_DECODE],
+           at[LATENCY_TICK] - at[LATENCY_CONSUME],
+           at[LATENCY_DRAW] - at[LATENCY_TICK],
+           at[LATENCY_SCANOUT] - at[LATENCY_DRAW]);
+  }
+  __atomic_store_n(&samples_tail, head, __ATOMIC_RELEASE);
+
+  for (uint source = 0; source < LATENCY_SOURCES; source++) {
+    // Nothing new, nothing to say
+    if (presses[source] == reported[source]) {
+      continue;
+    }
+    reported[source] = presses[source];
+
+    printf("LATENCY_HIST,%lu,%s,%lu", uptime_ms, source_names[source],
+           reported[source]);
+    for (uint i = 0; i < LATENCY_BUCKETS; i++) {
+      printf(",%lu", histogram[source][i]);
+    }
+    printf("\n");
+  }
+}
+
+uint32_t latency_last_us(enum latency_source source) {
+  return last_us[source];
+}
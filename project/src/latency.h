@@ -0,0 +1,81 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <pico.h>
+
+// Input-to-photon latency. One key press at a time is followed from the first
+// IR edge, or the arrival of a USB control packet, to the scanline that shows
+// the player's object at its new place, with a timestamp at every hand-over
+// in between. A press that arrives while another one is still in flight is
+// not measured.
+
+#define LATENCY_SAMPLES 8          // Finished presses kept for the next report
+#define LATENCY_BUCKET_MS 4        // Histogram bucket width
+#define LATENCY_BUCKETS 16         // The last bucket takes everything slower
+#define LATENCY_TIMEOUT_US 1000000 // A probe stuck this long is dropped
+
+// Hand-overs in pipeline order, each stamped by the code that owns it
+enum latency_stage {
+  LATENCY_EDGE,    // First edge of the IR frame, gpio_callback()
+  LATENCY_DECODE,  // Command decoded, IR timer callback
+  LATENCY_CONSUME, // Command picked up by the game logic task
+  LATENCY_TICK,    // Simulation step that used it has run
+  LATENCY_DRAW,    // Draw list holding that step written to the canvas
+  LATENCY_SCANOUT, // Scanline showing the player's object generated
+  LATENCY_STAGES,
+};
+
+// Where the press came from, figures are kept apart for the two
+enum latency_source {
+  LATENCY_IR,  // Remote, from the first edge of the NEC frame
+  LATENCY_USB, // CONTROL_INPUT packet, see control.h
+  LATENCY_SOURCES,
+};
+
+#define LATENCY_NO_LINE 0xffff  // Not waiting for a scanline
+#define LATENCY_ANY_LINE 0xfffe // Nothing moved, the next scanline counts
+
+// Screen line the render loop watches for, read on every scanline
+extern volatile uint16_t latency_scanout_line;
+
+// From gpio_callback() on the first edge of a frame
+void latency_edge(void);
+
+// Starts a probe for the IR frame whose first edge was seen last
+void latency_decoded(void);
+
+// Starts a probe for a USB input packet, edge and decode are both now
+void latency_received(void);
+
+// Stamps `stage` if the probe is waiting for it. Returns true if it was.
+bool latency_stamp(enum latency_stage stage);
+
+// The draw list with the probed step is on the canvas. `row` is the canvas
+// row of the player's object, or -1 if it did not move.
+void latency_drawn(int row);
+
+void latency_scanned_out(void);
+
+// Total of the last finished press from `source` in us, 0 if there was none
+uint32_t latency_last_us(enum latency_source source);
+
+static inline void latency_scanline(uint line) {
+  uint16_t wanted = latency_scanout_line;
+  if (wanted != LATENCY_NO_LINE &&
+      (wanted == line || wanted == LATENCY_ANY_LINE)) {
+    latency_scanned_out();
+  }
+}
+
+// Prints the presses finished since the last call and the running totals:
+//
+//   LATENCY,<uptime ms>,<ir|usb>,<total us>,<decode us>,<consume us>,
+//       <tick us>,<draw us>,<scanout us>             (one per press)
+//   LATENCY_HIST,<uptime ms>,<ir|usb>,<presses>,<bucket 0>,...,<bucket 15>
+//
+// Each stage figure is the time from the previous stage, so they add up to
+// the total. Buckets are LATENCY_BUCKET_MS wide. A USB press has no decode
+// time, the packet arrives whole.
+void latency_report(uint32_t uptime_ms);
+
+#endif
@@ -0,0 +1,147 @@
+#include <hardware/clocks.h>
+#include <hardware/irq.h>
+#include <hardware/pio.h>
+
+#include "link.h"
+#include "link.pio.h"
+
+#define LINK_PIO pio1
+
+static uint tx_sm;
+static uint rx_sm;
+static bool started = false;
+
+// Filled by the interrupt, drained by link_read() in the logic task
+static uint8_t rx_buffer[LINK_RX_BUFFER];
+static volatile uint32_t rx_head;
+static volatile uint32_t rx_tail;
+
+// Filled by link_write(), drained into the TX FIFO by the interrupt. At the
+// baud rate a packet takes 0.7 ms to go out, too long to wait for with the
+// game state locked.
+static uint8_t tx_buffer[LINK_TX_BUFFER];
+static volatile uint32_t tx_head;
+static volatile uint32_t tx_tail;
+
+static void __not_in_flash_func(link_rx_irq)(void) {
+  uint32_t head = rx_head;
+  while (!pio_sm_is_rx_fifo_empty(LINK_PIO, rx_sm)) {
+    uint8_t byte = (uint8_t)(pio_sm_get(LINK_PIO, rx_sm) >> 24);
+    if (head - __atomic_load_n(&rx_tail, __ATOMIC_ACQUIRE) < LINK_RX_BUFFER) {
+      rx_buffer[head & (LINK_RX_BUFFER - 1)] = byte;
+      head++;
+    }
+  }
+  __atomic_store_n(&rx_head, head, __ATOMIC_RELEASE);
+}
+
+static void link_tx_irq_enable(bool enabled) {
+  pio_set_irq1_source_enabled(
+      LINK_PIO, (enum pio_interrupt_source)(pis_sm0_tx_fifo_not_full + tx_sm),
+      enabled);
+}
+
+static void __not_in_flash_func(link_tx_irq)(void) {
+  uint32_t tail = tx_tail;
+  uint32_t head = __atomic_load_n(&tx_head, __ATOMIC_ACQUIRE);
+  while (tail != head && !pio_sm_is_tx_fifo_full(LINK_PIO, tx_sm)) {
+    pio_sm_put(LINK_PIO, tx_sm, tx_buffer[tail & (LINK_TX_BUFFER - 1)]);
+    tail++;
+  }
+  __atomic_store_n(&tx_tail, tail, __ATOMIC_RELEASE);
+
+  if (tail == head) {
+    // Nothing left, but link_write() may have queued more since the head
+    // was read. It enables the interrupt after moving the head, so looking
+    // again after disabling it cannot miss a write.
+    link_tx_irq_enable(false);
+    if (__atomic_load_n(&tx_head, __ATOMIC_ACQUIRE) != tail) {
+      link_tx_irq_enable(true);
+    }
+  }
+}
+
+static float link_clkdiv(void) {
+  return (float)clock_get_hz(clk_sys) / (8.0f * LINK_BAUD);
+}
+
+static void link_tx_init(uint offset) {
+  pio_sm_set_pins_with_mask(LINK_PIO, tx_sm, 1u << LINK_TX_PIN,
+                            1u << LINK_TX_PIN);
+  pio_sm_set_pindirs_with_mask(LINK_PIO, tx_sm, 1u << LINK_TX_PIN,
+                               1u << LINK_TX_PIN);
+  pio_gpio_init(LINK_PIO, LINK_TX_PIN);
+
+  pio_sm_config c = link_tx_program_get_default_config(offset);
+  sm_config_set_out_shift(&c, true, false, 32);
+  sm_config_set_out_pins(&c, LINK_TX_PIN, 1);
+  sm_config_set_sideset_pins(&c, LINK_TX_PIN);
+  sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&c, link_clkdiv());
+  pio_sm_init(LINK_PIO, tx_sm, offset, &c);
+
+  // Enabled by link_write() whenever there is something to send
+  irq_set_exclusive_handler(PIO1_IRQ_1, link_tx_irq);
+  irq_set_enabled(PIO1_IRQ_1, true);
+  pio_sm_set_enabled(LINK_PIO, tx_sm, true);
+}
+
+static void link_rx_init(uint offset) {
+  pio_sm_set_consecutive_pindirs(LINK_PIO, rx_sm, LINK_RX_PIN, 1, false);
+  pio_gpio_init(LINK_PIO, LINK_RX_PIN);
+  gpio_pull_up(LINK_RX_PIN); // No board attached reads as idle
+
+  pio_sm_config c = link_rx_program_get_default_config(offset);
+  sm_config_set_in_pins(&c, LINK_RX_PIN);
+  sm_config_set_jmp_pin(&c, LINK_RX_PIN);
+  sm_config_set_in_shift(&c, true, false, 32);
+  sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+  sm_config_set_clkdiv(&c, link_clkdiv());
+  pio_sm_init(LINK_PIO, rx_sm, offset, &c);
+
+  pio_set_irq0_source_enabled(
+      LINK_PIO, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + rx_sm),
+      true);
+  irq_set_exclusive_handler(PIO1_IRQ_0, link_rx_irq);
+  irq_set_enabled(PIO1_IRQ_0, true);
+  pio_sm_set_enabled(LINK_PIO, rx_sm, true);
+}
+
+void link_init(void) {
+  if (started) {
+    return;
+  }
+  started = true;
+
+  tx_sm = (uint)pio_claim_unused_sm(LINK_PIO, true);
+  rx_sm = (uint)pio_claim_unused_sm(LINK_PIO, true);
+  link_tx_init(pio_add_program(LINK_PIO, &link_tx_program));
+  link_rx_init(pio_add_program(LINK_PIO, &link_rx_program));
+}
+
+bool link_write(const void *data, uint len) {
+  const uint8_t *bytes = data;
+  uint32_t head = tx_head;
+  if (LINK_TX_BUFFER - (head - __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE)) <
+      len) {
+    return false;
+  }
+
+  for (uint i = 0; i < len; i++) {
+    tx_buffer[(head + i) & (LINK_TX_BUFFER - 1)] = bytes[i];
+  }
+  __atomic_store_n(&tx_head, head + len, __ATOMIC_RELEASE);
+  link_tx_irq_enable(true);
+  return true;
+}
+
+int link_read(void) {
+  uint32_t tail = rx_tail;
+  if (tail == __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE)) {
+    return -1;
+  }
+
+  uint8_t byte = rx_buffer[tail & (LINK_RX_BUFFER - 1)];
+  __atomic_store_n(&rx_tail, tail + 1, __ATOMIC_RELEASE);
+  return byte;
+}
@@ -0,0 +1,29 @@
+#ifndef _LINK_H_
+#define _LINK_H_
+
+#include <pico.h>
+
+// Byte link to a second board for lockstep play, see lockstep.h. The VGA
+// output and the IR receiver leave no hardware UART pins free on the Pico W,
+// so this is an 8n1 UART made of two PIO1 state machines. Cross TX and RX
+// between the boards and join their grounds.
+
+#define LINK_TX_PIN 26
+#define LINK_RX_PIN 27
+#define LINK_BAUD 460800   // A lockstep packet takes about 0.7 ms
+#define LINK_RX_BUFFER 256 // Bytes, must be a power of two
+#define LINK_TX_BUFFER 256 // Same for sending
+
+// Claims the state machines and starts receiving. Safe to call again.
+void link_init(void);
+
+// Queues the bytes for the TX interrupt and returns straight away. If they
+// do not all fit, none are queued and it returns false, lockstep sends the
+// same inputs again with the next packet.
+bool link_write(const void *data, uint len);
+
+// Next received byte, or -1 if there is none. Bytes that did not fit the
+// buffer are dropped, lockstep resends what matters.
+int link_read(void);
+
+#endif
@@ -0,0 +1,277 @@
+#include <assert.h>
+#include <string.h>
+
+#include "frame.h"
+#include "lockstep.h"
+
+#define LOCKSTEP_SLOT(tick) ((tick) & (LOCKSTEP_HISTORY - 1))
+
+// The peer may be this far ahead of our confirmed state with its inputs
+static_assert(LOCKSTEP_WINDOW + 2 * LOCKSTEP_INPUT_DELAY < LOCKSTEP_HISTORY,
+              "LOCKSTEP_HISTORY too short");
+
+void lockstep_init(struct lockstep *ls, uint32_t nonce) {
+  memset(ls, 0, sizeof(*ls));
+  ls->phase = LOCKSTEP_WAITING;
+  ls->nonce = nonce;
+}
+
+uint32_t lockstep_seed(const struct lockstep *ls) {
+  return ls->nonce ^ ls->peer_nonce;
+}
+
+void lockstep_start(struct lockstep *ls, const struct game_state *gs) {
+  ls->confirmed_state = *gs;
+  ls->confirmed_state.reset_score = false;
+  ls->confirmed = 0;
+  ls->ticks = 0;
+
+  // Neither side has input for the first ticks, that is the delay
+  memset(ls->inputs, GS_INPUT_NONE, sizeof(ls->inputs));
+  ls->known[LOCKSTEP_LEFT] = LOCKSTEP_INPUT_DELAY;
+  ls->known[LOCKSTEP_RIGHT] = LOCKSTEP_INPUT_DELAY;
+  ls->peer_ack = LOCKSTEP_INPUT_DELAY;
+  ls->mispredicted = false;
+
+  ls->hashes[0] = gs_hash(gs);
+  ls->peer_hash_tick = 0;
+  ls->silent = 0;
+  ls->phase = LOCKSTEP_RUNNING;
+}
+
+static uint8_t lockstep_remote(const struct lockstep *ls) {
+  return ls->side ^ 1;
+}
+
+// A peer hash for a tick we have confirmed too. Ticks gone from the history
+// are let go, the next packet brings a newer one.
+static void lockstep_check_hash(struct lockstep *ls, uint32_t tick,
+                                uint32_t hash) {
+  if (ls->confirmed - tick < LOCKSTEP_HISTORY &&
+      ls->hashes[LOCKSTEP_SLOT(tick)] != hash) {
+    ls->phase = LOCKSTEP_DESYNC;
+    ls->desync_tick = tick;
+  }
+}
+
+// One step of `gs` from `tick`, guessing the inputs not known yet
+static void lockstep_simulate(struct lockstep *ls, struct game_state *gs,
+                              uint32_t tick) {
+  uint8_t input[LOCKSTEP_SIDES];
+  for (uint side = 0; side < LOCKSTEP_SIDES; side++) {
+    uint32_t known = ls->known[side];
+    input[side] = ls->inputs[side][LOCKSTEP_SLOT(tick < known ? tick
+                                                              : known - 1)];
+  }
+
+  ls->guessed[LOCKSTEP_SLOT(tick)] = input[lockstep_remote(ls)];
+  gs_tick_versus(gs, input[LOCKSTEP_LEFT], input[LOCKSTEP_RIGHT]);
+}
+
+// Moves the confirmed state up to the last tick both inputs are known for
+static void lockstep_confirm(struct lockstep *ls) {
+  uint32_t limit = MIN(MIN(ls->known[LOCKSTEP_LEFT], ls->known[LOCKSTEP_RIGHT]),
+                       ls->ticks);
+
+  while (ls->confirmed < limit) {
+    uint32_t slot = LOCKSTEP_SLOT(ls->confirmed);
+    gs_tick_versus(&ls->confirmed_state, ls->inputs[LOCKSTEP_LEFT][slot],
+                   ls->inputs[LOCKSTEP_RIGHT][slot]);
+    // Only tells the drawing code to wipe the screen
+    ls->confirmed_state.reset_score = false;
+
+    ls->confirmed++;
+    ls->hashes[LOCKSTEP_SLOT(ls->confirmed)] = gs_hash(&ls->confirmed_state);
+    if (ls->peer_hash_tick == ls->confirmed) {
+      lockstep_check_hash(ls, ls->peer_hash_tick, ls->peer_hash);
+      ls->peer_hash_tick = 0;
+    }
+  }
+}
+
+static void lockstep_rollback(struct lockstep *ls, struct game_state *gs) {
+  bool reset_score = gs->reset_score; // Not drawn yet, keep it
+
+  *gs = ls->confirmed_state;
+  for (uint32_t tick = ls->confirmed; tick < ls->ticks; tick++) {
+    lockstep_simulate(ls, gs, tick);
+  }
+  gs->reset_score |= reset_score;
+
+  ls->rollbacks++;
+  ls->resimulated += ls->ticks - ls->confirmed;
+  ls->mispredicted = false;
+}
+
+void lockstep_receive(struct lockstep *ls, const struct lockstep_packet *p) {
+  if (p->nonce == ls->nonce) {
+    return; // Our own packet looped back, or an unlucky peer
+  }
+  if (ls->phase == LOCKSTEP_WAITING || p->nonce != ls->peer_nonce) {
+    // First packet of a peer, or the peer started over
+    ls->peer_nonce = p->nonce;
+    ls->side = p->nonce < ls->nonce ? LOCKSTEP_LEFT : LOCKSTEP_RIGHT;
+    ls->phase = LOCKSTEP_READY;
+    return;
+  }
+  if (ls->phase != LOCKSTEP_RUNNING) {
+    return;
+  }
+  ls->silent = 0;
+
+  uint8_t local = ls->side;
+  uint8_t remote = lockstep_remote(ls);
+
+  if (p->ack > ls->peer_ack && p->ack <= ls->known[local]) {
+    ls->peer_ack = p->ack;
+  }
+
+  for (uint i = 0; i < p->count && i < LOCKSTEP_PACKET_INPUTS; i++) {
+    uint32_t tick = p->first + i;
+    if (tick != ls->known[remote]) {
+      continue; // Already have it, the sender resends until acknowledged
+    }
+    if (tick - ls->confirmed >= LOCKSTEP_HISTORY) {
+      break; // Cannot happen with a well-behaved peer
+    }
+
+    uint8_t input = p->inputs[i] < GS_INPUT_COUNT ? p->inputs[i]
+                                                   : GS_INPUT_NONE;
+    ls->inputs[remote][LOCKSTEP_SLOT(tick)] = input;
+    ls->known[remote]++;
+    if (tick < ls->ticks && input != ls->guessed[LOCKSTEP_SLOT(tick)]) {
+      ls->mispredicted = true;
+    }
+  }
+
+  // Confirm first, the hash may be for a tick this has just completed
+  lockstep_confirm(ls);
+
+  if (p->hash_tick == 0) {
+    return;
+  }
+  if (p->hash_tick <= ls->confirmed) {
+    lockstep_check_hash(ls, p->hash_tick, p->hash);
+  } else if (ls->peer_hash_tick == 0) {
+    // Checked once we get there. Later ones are skipped meanwhile, or a
+    // peer that is always ahead would never be checked at all.
+    ls->peer_hash_tick = p->hash_tick;
+    ls->peer_hash = p->hash;
+  }
+}
+
+bool lockstep_tick(struct lockstep *ls, struct game_state *gs,
+                   uint8_t local_input) {
+  if (ls->phase != LOCKSTEP_RUNNING) {
+    return false;
+  }
+
+  // Unplugged, reset or playing something else. Stalling would freeze the
+  // game for good.
+  if (++ls->silent > LOCKSTEP_PEER_TIMEOUT) {
+    ls->phase = LOCKSTEP_LOST;
+    return false;
+  }
+
+  uint8_t local = ls->side;
+  uint8_t remote = lockstep_remote(ls);
+
+  // Too far ahead of the peer's inputs, or of what it has of ours
+  if (ls->ticks >= ls->known[remote] + LOCKSTEP_WINDOW ||
+      ls->known[local] - ls->peer_ack >= LOCKSTEP_PACKET_INPUTS) {
+    ls->stalls++;
+    return false;
+  }
+
+  ls->inputs[local][LOCKSTEP_SLOT(ls->known[local])] = local_input;
+  ls->known[local]++;
+
+  lockstep_confirm(ls);
+  if (ls->mispredicted) {
+    lockstep_rollback(ls, gs);
+  }
+
+  lockstep_simulate(ls, gs, ls->ticks);
+  ls->ticks++;
+  return true;
+}
+
+void lockstep_packet(const struct lockstep *ls, struct lockstep_packet *p) {
+  memset(p, 0, sizeof(*p));
+  p->nonce = ls->nonce;
+  if (ls->phase != LOCKSTEP_RUNNING) {
+    return;
+  }
+
+  uint8_t local = ls->side;
+
+  // Everything the peer has not acknowledged, stalling keeps it to a packet
+  p->ack = ls->known[lockstep_remote(ls)];
+  p->first = ls->peer_ack;
+  p->count = (uint8_t)(ls->known[local] - ls->peer_ack);
+  for (uint i = 0; i < p->count; i++) {
+    p->inputs[i] = ls->inputs[local][LOCKSTEP_SLOT(p->first + i)];
+  }
+
+  p->hash_tick = ls->confirmed;
+  p->hash = ls->hashes[LOCKSTEP_SLOT(ls->confirmed)];
+}
+
+// -------- Wire format --------
+
+static uint8_t *lockstep_put32(uint8_t *out, uint32_t value) {
+  for (uint i = 0; i < 4; i++) {
+    *out++ = (uint8_t)(value >> (8 * i));
+  }
+  return out;
+}
+
+static const uint8_t *lockstep_get32(const uint8_t *in, uint32_t *value) {
+  *value = 0;
+  for (uint i = 0; i < 4; i++) {
+    *value |= (uint32_t)*in++ << (8 * i);
+  }
+  return in;
+}
+
+static bool lockstep_payload_valid(const uint8_t *frame) {
+  return frame[1] <= LOCKSTEP_PACKET_INPUTS;
+}
+
+static const struct frame_format lockstep_frame = {
+    .sync = LOCKSTEP_SYNC,
+    .size = LOCKSTEP_PACKET_SIZE,
+    .valid = lockstep_payload_valid,
+};
+
+void lockstep_encode(const struct lockstep_packet *p,
+                     uint8_t out[LOCKSTEP_PACKET_SIZE]) {
+  uint8_t *at = &out[1];
+  *at++ = p->count;
+  at = lockstep_put32(at, p->nonce);
+  at = lockstep_put32(at, p->ack);
+  at = lockstep_put32(at, p->first);
+  at = lockstep_put32(at, p->hash_tick);
+  at = lockstep_put32(at, p->hash);
+  memcpy(at, p->inputs, LOCKSTEP_PACKET_INPUTS);
+  frame_seal(&lockstep_frame, out);
+}
+
+bool lockstep_decode(struct lockstep_decoder *decoder, uint8_t byte,
+                     struct lockstep_packet *p) {
+  if (!frame_decode(&lockstep_frame, decoder->buf, &decoder->used, byte)) {
+    return false;
+  }
+
+  const uint8_t *at = &decoder->buf[1];
+  p->count = *at++;
+  at = lockstep_get32(at, &p->nonce);
+  at = lockstep_get32(at, &p->ack);
+  at = lockstep_get32(at, &p->first);
+  at = lockstep_get32(at, &p->hash_tick);
+  at = lockstep_get32(at, &p->hash);
+  memcpy(p->inputs, at, LOCKSTEP_PACKET_INPUTS);
+  return true;
+}
+
+// -------- Wire format --------
@@ -0,0 +1,132 @@
+#ifndef _LOCKSTEP_H_
+#define _LOCKSTEP_H_
+
+#include <pico.h>
+
+#include "game.h"
+
+// Two-board lockstep for Pong versus play. The boards only exchange their
+// per-tick GS_INPUT_* and both run gs_tick_versus() with the same pair, so
+// the simulations stay identical without ever sending state.
+//
+// The remote input of a tick is guessed (its last known input repeated) until
+// it arrives, so the game never waits for the link. A wrong guess rolls the
+// state back to the last tick both inputs were known for and simulates the
+// ticks since again. A side that gets LOCKSTEP_WINDOW ticks ahead of the
+// other's inputs stalls instead. Every packet carries the hash of the
+// sender's last confirmed state, a mismatch stops the session as a desync.
+// A peer that sends nothing for LOCKSTEP_PEER_TIMEOUT ticks is given up on.
+//
+// Nothing here does I/O: packets are built and taken in as structs and
+// turned into bytes with lockstep_encode() and lockstep_decode().
+
+#define LOCKSTEP_INPUT_DELAY 2 // Local inputs apply this many ticks later
+#define LOCKSTEP_WINDOW 6      // Ticks run ahead on guessed remote inputs
+#define LOCKSTEP_HISTORY 16    // Inputs and hashes kept, a power of two
+#define LOCKSTEP_PACKET_INPUTS 8 // Unacknowledged inputs resent per packet
+#define LOCKSTEP_PEER_TIMEOUT 60 // Ticks without a packet before the peer is
+                                 // lost, about two seconds
+
+// -------- Wire format --------
+//
+// LOCKSTEP_SYNC | count | nonce | ack | first | hash_tick | hash |
+//     inputs[LOCKSTEP_PACKET_INPUTS] | checksum
+//
+// Integers are little endian 32-bit, the checksum is the XOR of the bytes
+// between the sync and itself.
+
+#define LOCKSTEP_SYNC 0xC3
+#define LOCKSTEP_PACKET_SIZE (2 + 5 * 4 + LOCKSTEP_PACKET_INPUTS + 1)
+
+struct lockstep_packet {
+  uint32_t nonce;     // Picks the sides and the seed, see lockstep_init()
+  uint32_t ack;       // Inputs of the receiver the sender has
+  uint32_t first;     // Tick of inputs[0]
+  uint8_t count;      // Inputs carried, 0 while waiting for a peer
+  uint32_t hash_tick; // Ticks in the sender's confirmed state
+  uint32_t hash;      // gs_hash() of it
+  uint8_t inputs[LOCKSTEP_PACKET_INPUTS];
+};
+
+struct lockstep_decoder {
+  uint8_t buf[LOCKSTEP_PACKET_SIZE];
+  uint8_t used;
+};
+
+// -------- Wire format --------
+
+enum lockstep_side {
+  LOCKSTEP_LEFT, // Plays GAME_ENTITY_PLAYER
+  LOCKSTEP_RIGHT, // Plays GAME_ENTITY_AI's paddle
+  LOCKSTEP_SIDES,
+};
+
+enum lockstep_phase {
+  LOCKSTEP_WAITING, // No packet from a peer yet
+  LOCKSTEP_READY,   // Peer known, waiting for lockstep_start()
+  LOCKSTEP_RUNNING,
+  LOCKSTEP_DESYNC,
+  LOCKSTEP_LOST, // Peer silent for LOCKSTEP_PEER_TIMEOUT ticks
+};
+
+struct lockstep {
+  uint8_t phase; // enum lockstep_phase
+  uint8_t side;  // enum lockstep_side, valid once READY
+  uint32_t nonce;
+  uint32_t peer_nonce;
+
+  // State after the first `confirmed` ticks, all of them with real inputs
+  struct game_state confirmed_state;
+  uint32_t confirmed;
+  uint32_t ticks; // Ticks in the caller's (predicted) state
+
+  uint8_t inputs[LOCKSTEP_SIDES][LOCKSTEP_HISTORY]; // By tick
+  uint32_t known[LOCKSTEP_SIDES];                   // Inputs per side so far
+  uint8_t guessed[LOCKSTEP_HISTORY]; // Remote input the prediction used
+  bool mispredicted;                 // A guess turned out wrong
+
+  uint32_t hashes[LOCKSTEP_HISTORY]; // Of the confirmed state, by tick
+  uint32_t peer_ack;
+  uint32_t peer_hash_tick; // Peer hash not checked yet, tick 0 = none
+  uint32_t peer_hash;
+  uint32_t desync_tick;
+  uint32_t silent; // Ticks since the last packet of the peer
+
+  // Counters for the curious
+  uint32_t rollbacks;
+  uint32_t resimulated; // Ticks simulated again by rollbacks
+  uint32_t stalls;
+};
+
+// Both boards pick a random nonce. The higher one plays the left side and
+// their XOR seeds the game. Equal nonces never pair up.
+void lockstep_init(struct lockstep *ls, uint32_t nonce);
+
+// Seed for the shared starting state, valid once the phase is READY
+uint32_t lockstep_seed(const struct lockstep *ls);
+
+// Begins tick 0 from `gs`, which both boards must have built the same way
+void lockstep_start(struct lockstep *ls, const struct game_state *gs);
+
+// Takes in a packet from the peer
+void lockstep_receive(struct lockstep *ls, const struct lockstep_packet *p);
+
+// Advances `gs` by one tick with the local player's input. Returns false if
+// the tick had to stall or the peer was lost, gs is then unchanged. A
+// rollback may rewrite every entity, x_old and y_old then only describe the
+// last simulated step.
+bool lockstep_tick(struct lockstep *ls, struct game_state *gs,
+                   uint8_t local_input);
+
+// The packet to send now, once per tick is enough
+void lockstep_packet(const struct lockstep *ls, struct lockstep_packet *p);
+
+void lockstep_encode(const struct lockstep_packet *p,
+                     uint8_t out[LOCKSTEP_PACKET_SIZE]);
+
+// Feeds one received byte. Returns true when it completed a valid packet,
+// which is then in *p.
+bool lockstep_decode(struct lockstep_decoder *decoder, uint8_t byte,
+                     struct lockstep_packet *p);
+
+#endif
@@ -0,0 +1,111 @@
+#include <FreeRTOS.h>
+#include <assert.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <pico/stdio_usb.h>
+#include <string.h>
+#include <task.h>
+
+#include "log.h"
+#include "usb_stream.h"
+
+#define LOG_CORES 2
+#define LOG_RECORDS_PER_FRAME                                                  \
+  (USB_STREAM_MAX_PAYLOAD / sizeof(struct log_record))
+
+// Single producer (the owning core) and single consumer (log_task)
+struct log_ring {
+  struct log_record records[LOG_RING_RECORDS];
+  uint32_t head;    // Records ever written, only the owning core stores it
+  uint32_t tail;    // Records ever sent, only log_task stores it
+  uint32_t dropped; // Records lost to a full ring, owning core only
+};
+
+static struct log_ring rings[LOG_CORES];
+
+static_assert(sizeof(struct log_record) == 16, "tools/log2text.py RECORD");
+
+void __not_in_flash_func(log_write)(uint16_t format, uint32_t arg0,
+                                    uint32_t arg1) {
+  // A task is only switched out, or moved to the other core, from an
+  // interrupt. With them masked this core's ring has no other writer, and
+  // the core number read here stays the one the record goes to.
+  uint32_t irq = save_and_disable_interrupts();
+  uint core = get_core_num();
+  struct log_ring *ring = &rings[core];
+  uint32_t head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >=
+      LOG_RING_RECORDS) {
+    ring->dropped++;
+  } else {
+    struct log_record *record = &ring->records[head & (LOG_RING_RECORDS - 1)];
+    record->timestamp = time_us_32();
+    record->format = format;
+    record->core = (uint8_t)core;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+
+    // The record is complete before the drain can see it
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  }
+  restore_interrupts(irq);
+}
+
+static bool log_send(const struct log_record *records, uint32_t count) {
+  return usb_stream_write(USB_STREAM_LOG, records,
+                          (uint16_t)(count * sizeof(struct log_record)));
+}
+
+static void log_drain_ring(uint core) {
+  static uint32_t reported[LOG_CORES];
+  struct log_ring *ring = &rings[core];
+  struct log_record batch[LOG_RECORDS_PER_FRAME];
+
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t tail = ring->tail;
+  while (tail != head) {
+    uint32_t count = MIN(head - tail, LOG_RECORDS_PER_FRAME);
+    for (uint32_t i = 0; i < count; i++) {
+      batch[i] = ring->records[(tail + i) & (LOG_RING_RECORDS - 1)];
+    }
+    if (!log_send(batch, count)) {
+      return; // Kept for when a host shows up, new records are dropped
+    }
+
+    tail += count;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  // The counter belongs to the writer, so the drain only remembers how much
+  // of it has been reported
+  uint32_t dropped = ring->dropped;
+  if (dropped != reported[core]) {
+    struct log_record record = {
+        .timestamp = time_us_32(),
+        .format = LOG_DROPPED,
+        .core = (uint8_t)core,
+        .args = {dropped - reported[core]},
+    };
+    if (log_send(&record, 1)) {
+      reported[core] = dropped;
+    }
+  }
+}
+
+void log_task(void *pvParameters) {
+  (void)pvParameters;
+
+  TickType_t xLastWakeTime = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(LOG_DRAIN_PERIOD_MS));
+
+    if (!stdio_usb_connected()) {
+      continue;
+    }
+
+    for (uint core = 0; core < LOG_CORES; core++) {
+      log_drain_ring(core);
+    }
+  }
+}
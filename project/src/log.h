@@ -0,0 +1,60 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <pico.h>
+
+// Deferred logging for interrupt handlers and high priority tasks. A call
+// site only stores a format id and up to two raw arguments in its core's
+// ring, with interrupts masked for a handful of stores. log_task() sends the
+// records over USB (USB_STREAM_LOG) and tools/log2text.py does the
+// formatting on the host, reading the formats straight from this file.
+
+#define LOG_RING_RECORDS 64 // Per core, must be a power of two
+#define LOG_DRAIN_PERIOD_MS 50
+
+// -------- Formats --------
+//
+// X(id, format), printf style with at most two integer conversions. New
+// formats go at the end, the host numbers them in the order they appear.
+
+#define LOG_FORMATS(X)                                                         \
+  X(LOG_DROPPED, "%u log records dropped")                                     \
+  X(LOG_IR_TOO_SHORT, "Insufficient events to decode")                         \
+  X(LOG_IR_BAD_START, "Invalid start sequence. Message discarded.")            \
+  X(LOG_IR_REPEAT, "Repeat message")                                           \
+  X(LOG_IR_BAD_TIMING, "Invalid timing (%u us). Message discarded.")           \
+  X(LOG_IR_OVERFLOW, "Buffer overflow! Clearing buffer.")                      \
+  X(LOG_REPLAY_EXACT, "Replay finished after %u ticks: bit-exact")             \
+  X(LOG_REPLAY_DESYNC, "Replay finished after %u ticks: DESYNC at tick %u")   \
+  X(LOG_LOCKSTEP_PAIRED, "Lockstep: paired, playing side %u (0 = left)")      \
+  X(LOG_LOCKSTEP_DESYNC, "Lockstep: DESYNC at tick %u, pairing again")        \
+  X(LOG_LOCKSTEP_LOST, "Lockstep: peer silent at tick %u, pairing again")
+
+#define LOG_FORMAT_ID(id, format) id,
+enum log_format { LOG_FORMATS(LOG_FORMAT_ID) LOG_FORMAT_COUNT };
+#undef LOG_FORMAT_ID
+
+// -------- Formats --------
+
+// -------- Stream format --------
+//
+// USB_STREAM_LOG payloads are a run of struct log_record, little endian
+
+struct log_record {
+  uint32_t timestamp; // Microseconds, shared timer so both cores agree
+  uint16_t format;    // enum log_format
+  uint8_t core;
+  uint8_t reserved;
+  uint32_t args[2];
+};
+
+// -------- Stream format --------
+
+// Never blocks and never formats. A full ring drops the record and counts it,
+// the count is reported as LOG_DROPPED once there is room again.
+void log_write(uint16_t format, uint32_t arg0, uint32_t arg1);
+
+// Low priority FreeRTOS task that drains both rings every LOG_DRAIN_PERIOD_MS
+void log_task(void *pvParameters);
+
+#endif
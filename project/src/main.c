@@ -3,8 +3,9 @@
 
 // Pico SDK
 #include <pico.h>
-#include <pico/multicore.h>
+#include <pico/mutex.h>
 #include <pico/stdlib.h>
+#include <pico/time.h>
 
 // FreeRTOS
 #include <FreeRTOS.h>
@@ -14,179 +15,441 @@
 #include <timers.h>
 
 // Project specific
-#include "game.h"
+#include "arcade.h"
+#include "audio.h"
+#include "blend.h"
+#include "capture.h"
+#include "control.h"
+#include "draw.h"
 #include "infrared.h"
+#include "jobs.h"
+#include "latency.h"
+#include "log.h"
+#include "membench.h"
+#include "pong.h"
+#include "replay.h"
+#include "stats.h"
+#include "trace.h"
+#include "usb_stream.h"
 #include "vga.h"
 
+// Scanline generation owns core 1 and outranks everything, it only gives the
+// core away while every scanline buffer is already queued for scan-out
+#define mainRENDER_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#define mainRENDER_TASK_CORE 1
+#define mainRENDER_RETRY_US 16 // A quarter of a 320x240 line
+
 #define mainGAME_LOGIC_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
 #define mainGAME_DRAW_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
 
+// Above the logic task so a USB input is in place before the next tick
+#define mainCONTROL_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
+
+#define mainREPLAY_STREAM_TASK_PRIORITY (tskIDLE_PRIORITY)
+#define mainSTATS_TASK_PRIORITY (tskIDLE_PRIORITY)
+#define mainTRACE_TASK_PRIORITY (tskIDLE_PRIORITY)
+#define mainCAPTURE_TASK_PRIORITY (tskIDLE_PRIORITY)
+#define mainLOG_TASK_PRIORITY (tskIDLE_PRIORITY)
+
+// Set to 1 to measure canvas fill and scanout throughput before starting
+#ifndef mainRUN_MEMBENCH
+#define mainRUN_MEMBENCH 0
+#endif
+
+// Set to 1 to stream the screen to the host, see capture.h
+#ifndef mainRUN_CAPTURE
+#define mainRUN_CAPTURE 0
+#endif
+
+#define mainBANNER_TICKS 60      // Game name shown for about two seconds
+#define mainBANNER_FADE_TICKS 16 // Last ticks of it spent fading out
+
+#define mainREPLAY_STREAM_PERIOD_MS 100 // How often it is pushed over USB
+
+#define mainLOGIC_PERIOD_MS 33     // Default logic tick period
+#define mainLOGIC_PERIOD_MIN_MS 5  // Range CONTROL_PARAM_TICK_MS accepts
+#define mainLOGIC_PERIOD_MAX_MS 200
+#define mainCONTROL_POLL_MS 20 // Input is read at least this often
+
 volatile ir_event_t event_buffer[IR_BUFFER_SIZE]; // Buffer to store events
 volatile uint16_t event_count = 0;                // Number of events stored
 volatile uint8_t ir_command = 0;
 
+#if configAPPLICATION_ALLOCATED_HEAP
+// Fills SRAM3 behind the canvas in the banked layout, heap_1 never needs it
+// zeroed
+uint8_t ucHeap[configTOTAL_HEAP_SIZE] __attribute__((section(".banked_bss")));
+#endif
+
 static void prvSetupHardware(void);
 static void prvLaunchRTOS();
 
+// Games selectable with the IR number keys 3 and up
+static const struct arcade_game *const games[] = {
+    &pong_game,
+    &breakout_game,
+};
+static const struct arcade_game *current_game = &pong_game;
+
 static struct mutex render_sync_mutex; // Probably unnecessary
 static struct mutex game_state_mutex;  // Probably unnecessary
 
-void render_loop() {
+// Drawing commands recorded by the logic task, replayed by the draw task
+static struct draw_queue draw_queue;
+static uint8_t banner_ticks = 0;
+
+static volatile uint32_t logic_period_ms = mainLOGIC_PERIOD_MS;
+static volatile uint32_t logic_ticks = 0;
+
+static TaskHandle_t xControlTask = NULL;
+
+// USB packets, the input in flight is answered once a tick has used it
+static struct control_device control_device;
+
+// Takes a mutex, recording in the trace ring how long it had to wait if it
+// was not free
+static void prvMutexEnter(struct mutex *mtx, enum trace_mutex id) {
+  if (!mutex_try_enter(mtx, NULL)) {
+    trace_record(TRACE_MUTEX_WAIT, (uint8_t)id, 0);
+    mutex_enter_blocking(mtx);
+    trace_record(TRACE_MUTEX_TAKEN, (uint8_t)id, 0);
+  }
+}
+
+// Taken by draw_execute() on the draw task around its canvas writes
+static void prvCanvasEnter(void) {
+  prvMutexEnter(&render_sync_mutex, TRACE_MUTEX_RENDER);
+}
+
+static void prvCanvasExit(void) { mutex_exit(&render_sync_mutex); }
+
+static const struct draw_lock canvas_lock = {
+    .enter = prvCanvasEnter,
+    .exit = prvCanvasExit,
+};
+
+static TaskHandle_t xRenderTask = NULL;
+
+// The render task's way into the canvas. Whoever holds it is usually waiting
+// on a batch of drawing jobs, so help with those instead of blocking.
+static void __not_in_flash_func(prvRenderLock)(void) {
+  if (mutex_try_enter(&render_sync_mutex, NULL)) {
+    return;
+  }
+
+  trace_record(TRACE_MUTEX_WAIT, TRACE_MUTEX_RENDER, 0);
+  while (!mutex_try_enter(&render_sync_mutex, NULL)) {
+    if (!jobs_run_one()) {
+      mutex_enter_blocking(&render_sync_mutex);
+      break;
+    }
+  }
+  trace_record(TRACE_MUTEX_TAKEN, TRACE_MUTEX_RENDER, 0);
+}
+
+static int64_t __not_in_flash_func(prvRenderWake)(alarm_id_t id,
+                                                  void *user_data) {
+  (void)id;
+  (void)user_data;
+
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(xRenderTask, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+  return 0;
+}
+
+static void __not_in_flash_func(prvRenderTask)(void *pvParameters) {
+  (void)pvParameters;
+
+  // The affinity mask keeps this on core 1, so scanvideo claims its
+  // interrupts there and the wake-up alarm fires there too
   vga_init();
+  alarm_pool_t *wake_pool = alarm_pool_create_with_unused_hardware_alarm(2);
 
   while (true) {
     // Begin scanline generation
     struct scanvideo_scanline_buffer *scanline_buffer =
-        scanvideo_begin_scanline_generation(true);
+        scanvideo_begin_scanline_generation(false);
+    if (scanline_buffer == NULL) {
+      // Every buffer is waiting for scan-out. Shared drawing jobs come first,
+      // then let the other core 1 work run until a buffer has most likely
+      // been freed. The tick timeout covers a failed alarm.
+      if (jobs_run_one()) {
+        continue;
+      }
+      alarm_pool_add_alarm_in_us(wake_pool, mainRENDER_RETRY_US,
+                                 prvRenderWake, NULL, true);
+      ulTaskNotifyTake(pdTRUE, 1);
+      continue;
+    }
 
-    mutex_enter_blocking(&render_sync_mutex);
+    uint16_t scanline = scanvideo_scanline_number(scanline_buffer->scanline_id);
+    trace_record(TRACE_SCANLINE_BEGIN, 0, scanline);
+    if (scanline == 0) {
+      stats_xip_frame();
+    }
+    uint32_t xip_window = stats_xip_window_begin();
 
-    uint16_t *canvas = vga_get_canvas();
+    prvRenderLock();
 
-    // Update canvas slice and render the scanline
-    uint16_t *current_slice = vga_get_next_canvas_slice(canvas);
-    vga_render_scanline(scanline_buffer, current_slice);
+    // Render the scanline from whatever row the view puts on it
+    vga_render_scanline(scanline_buffer, scanline);
+    latency_scanline(scanline);
 
     mutex_exit(&render_sync_mutex);
 
     // End scanline generation
     scanvideo_end_scanline_generation(scanline_buffer);
+    stats_xip_window_end(xip_window);
+    trace_record(TRACE_SCANLINE_END, 0, scanline);
   }
 }
 
-void update_canvas(struct game_state *gs) {
+// Shows the game name in the top left corner for a while after a switch.
+// Recorded every tick because the game may clear the canvas on its own.
+static void prvDrawBanner(struct draw_list *list) {
+  if (banner_ticks == 0) {
+    return;
+  }
 
-  struct pong_rect player_goal = {
-      .x = 20,
-      .y = 0,
-      .w = 1,
-      .h = CANVAS_HEIGHT,
-      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x00, 0x33, 0x00),
-  };
+  const char *name = current_game->name;
+  size_t len = strlen(name) < DRAW_TEXT_MAX ? strlen(name) : DRAW_TEXT_MAX;
+  uint16_t width = (uint16_t)(len * DRAW_GLYPH_ADVANCE);
+
+  if (--banner_ticks > 0) {
+    draw_text(list, 2, 2, name,
+              (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x10, 0x10, 0x10));
+    if (banner_ticks < mainBANNER_FADE_TICKS) {
+      // Redrawn solid every tick and faded further each time
+      uint alpha = BLEND_ALPHA_MAX -
+                   banner_ticks * BLEND_ALPHA_MAX / mainBANNER_FADE_TICKS;
+      draw_fade(list, 2, 2, width, DRAW_GLYPH_H, 0, (uint8_t)alpha);
+    }
+  } else {
+    draw_fill(list, 2, 2, width, DRAW_GLYPH_H, 0);
+  }
+}
 
-  struct pong_rect mid_line = {
-      .x = CANVAS_WIDTH / 2,
-      .y = 0,
-      .w = 1,
-      .h = CANVAS_HEIGHT,
-      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xaa, 0xaa, 0xaa),
-  };
+// Swaps the hosted game. Must be called with game_state_mutex held.
+static void prvSwitchGame(const struct arcade_game *game) {
+  current_game = game;
 
-  struct pong_rect ai_goal = {
-      .x = CANVAS_WIDTH - 20,
-      .y = 0,
-      .w = 1,
-      .h = CANVAS_HEIGHT,
-      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x33, 0x00, 0x00),
-  };
+  struct draw_list *list = draw_queue_writer(&draw_queue);
+  draw_clear(list);
+  draw_view(list, 0, 0, 0, 0);
+  draw_background(list, &(struct vga_background){.mode = VGA_BACKGROUND_OFF});
+  banner_ticks = mainBANNER_TICKS;
 
-  uint16_t *canvas = vga_get_canvas();
-  mutex_enter_blocking(&render_sync_mutex);
-  { vga_draw_rectangle_filled(canvas, &player_goal); }
-  mutex_exit(&render_sync_mutex);
+  current_game->init();
+}
 
-  mutex_enter_blocking(&render_sync_mutex);
-  { vga_draw_rectangle_filled(canvas, &mid_line); }
-  mutex_exit(&render_sync_mutex);
+static void prvGameLogicTask(void *pvParameters) {
+  (void)pvParameters;
 
-  mutex_enter_blocking(&render_sync_mutex);
-  { vga_draw_rectangle_filled(canvas, &ai_goal); }
-  mutex_exit(&render_sync_mutex);
+  TickType_t xLastWakeTime = xTaskGetTickCount();
 
-  pong_rect objects[] = {gs->ball, gs->player, gs->ai};
-  // Render all objects
-  for (uint i = 0; i < sizeof(objects) / sizeof(objects[0]); i++) {
-    mutex_enter_blocking(&render_sync_mutex);
+  for (;;) {
+    // Every command is consumed exactly once, also against a write from
+    // the other core
+    uint8_t command =
+        __atomic_exchange_n(&ir_command, IR_C_OK, __ATOMIC_ACQ_REL);
+    bool received = command != IR_C_OK;
+    if (received) {
+      latency_stamp(LATENCY_CONSUME);
+    }
+
+    prvMutexEnter(&game_state_mutex, TRACE_MUTEX_GAME);
     {
-      mutex_enter_blocking(&game_state_mutex);
-      { vga_draw_rectangle_filled(canvas, &objects[i]); }
-      mutex_exit(&game_state_mutex);
+      if (command == IR_C_N3 || command == IR_C_N4) {
+        prvSwitchGame(games[command == IR_C_N3 ? 0 : 1]);
+        command = IR_C_OK;
+      }
+
+      current_game->update(current_game->input(command));
+      current_game->draw(draw_queue_writer(&draw_queue));
+      prvDrawBanner(draw_queue_writer(&draw_queue));
+      if (latency_stamp(LATENCY_TICK)) {
+        draw_queue_writer(&draw_queue)->latency_probe = true;
+      }
     }
-    mutex_exit(&render_sync_mutex);
-  }
+    mutex_exit(&game_state_mutex);
 
-  mutex_enter_blocking(&game_state_mutex);
+    draw_queue_publish(&draw_queue);
+    logic_ticks++;
 
-  if (gs->reset_score) {
-    mutex_enter_blocking(&render_sync_mutex);
-    vga_clear_canvas(canvas);
-    mutex_exit(&render_sync_mutex);
+    if (received && control_device.input_state == CONTROL_INPUT_WAITING) {
+      control_input_used(&control_device);
+      xTaskNotifyGive(xControlTask);
+    }
 
-    gs->reset_score = false;
+    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(logic_period_ms));
+  }
+}
+
+static void prvControlReply(const struct control_packet *packet,
+                            uint8_t status, int32_t value) {
+  struct control_reply reply = {
+      .type = packet->type,
+      .seq = packet->seq,
+      .status = status,
+      .arg = packet->arg,
+      .value = value,
+      .time_us = time_us_32(),
+  };
+  usb_stream_write(USB_STREAM_CONTROL, &reply, sizeof(reply));
+}
+
+static uint8_t prvControlSet(uint8_t param, int16_t value) {
+  switch (param) {
+  case CONTROL_PARAM_GAME:
+    if (value < 0 || value >= (int16_t)count_of(games)) {
+      return CONTROL_BAD_ARG;
+    }
+    prvMutexEnter(&game_state_mutex, TRACE_MUTEX_GAME);
+    prvSwitchGame(games[value]);
     mutex_exit(&game_state_mutex);
+    return CONTROL_OK;
+  case CONTROL_PARAM_TICK_MS:
+    if (value < mainLOGIC_PERIOD_MIN_MS || value > mainLOGIC_PERIOD_MAX_MS) {
+      return CONTROL_BAD_ARG;
+    }
+    logic_period_ms = (uint32_t)value;
+    return CONTROL_OK;
+  default:
+    return CONTROL_BAD_ARG;
+  }
+}
 
-    return;
+static uint8_t prvControlGet(uint8_t state, int32_t *value) {
+  switch (state) {
+  case CONTROL_STATE_TICKS:
+    *value = (int32_t)logic_ticks;
+    return CONTROL_OK;
+  case CONTROL_STATE_GAME:
+    for (uint i = 0; i < count_of(games); i++) {
+      if (games[i] == current_game) {
+        *value = (int32_t)i;
+      }
+    }
+    return CONTROL_OK;
+  case CONTROL_STATE_LATENCY_IR:
+    *value = (int32_t)latency_last_us(LATENCY_IR);
+    return CONTROL_OK;
+  case CONTROL_STATE_LATENCY_USB:
+    *value = (int32_t)latency_last_us(LATENCY_USB);
+    return CONTROL_OK;
+  default:
+    return CONTROL_BAD_ARG;
   }
+}
 
-  for (uint i = 0; i < gs->ai_score; i++) {
-    int prev_pos = gs->draw_point_ai.x;
-    gs->draw_point_ai.x += i * 10;
+// Runs on the Control task
+static void prvControlInput(uint8_t command) {
+  latency_received();
+  __atomic_store_n(&ir_command, command, __ATOMIC_RELEASE);
+}
 
-    mutex_enter_blocking(&render_sync_mutex);
-    { vga_draw_rectangle_filled(canvas, &gs->draw_point_ai); }
-    mutex_exit(&render_sync_mutex);
+static uint32_t prvControlNow(void) { return time_us_32(); }
 
-    gs->draw_point_ai.x = prev_pos;
-  }
+static struct control_device control_device = {
+    .reply = prvControlReply,
+    .set = prvControlSet,
+    .get = prvControlGet,
+    .input = prvControlInput,
+    .now_us = prvControlNow,
+};
 
-  for (uint i = 0; i < gs->player_score; i++) {
-    int prev_pos = gs->draw_point_player.x;
-    gs->draw_point_player.x -= i * 10 - gs->draw_point_player.w;
+static void prvControlWake(void *param) {
+  (void)param;
 
-    mutex_enter_blocking(&render_sync_mutex);
-    { vga_draw_rectangle_filled(canvas, &gs->draw_point_player); }
-    mutex_exit(&render_sync_mutex);
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(xControlTask, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-    gs->draw_point_player.x = prev_pos;
-  }
+// Reads control packets from USB stdio, woken by the USB driver as bytes
+// arrive and by the logic task when it used an input
+static void prvControlTask(void *pvParameters) {
+  (void)pvParameters;
+
+  struct control_decoder decoder = {0};
+  stdio_set_chars_available_callback(prvControlWake, NULL);
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(mainCONTROL_POLL_MS));
+
+    control_poll(&control_device);
 
-  mutex_exit(&game_state_mutex);
+    int c;
+    while ((c = getchar_timeout_us(0)) >= 0) {
+      struct control_packet packet;
+      if (control_decode(&decoder, (uint8_t)c, &packet)) {
+        control_handle(&control_device, &packet);
+      }
+    }
+  }
 }
 
-static void prvGameLogicTask(void *pvParameters) {
-  struct game_state *gs = pvParameters;
+static void prvReplayStreamTask(void *pvParameters) {
+  struct replay_recorder *rec = pvParameters;
 
-  TickType_t xLastWakeTime = xTaskGetTickCount();
-  const TickType_t xFrequency = pdMS_TO_TICKS(33);
+  uint32_t generation = rec->generation;
+  uint32_t sent = 0;
 
   for (;;) {
-    int move_direction = 0; // Default: no movement
-
-    // Map IR commands to movement
-    if (ir_command == IR_C_UP) {
-      move_direction = -1;  // Up
-      ir_command = IR_C_OK; // Reset command
-    } else if (ir_command == IR_C_DOWN) {
-      move_direction = 1;   // Down
-      ir_command = IR_C_OK; // Reset command
+    if (rec->generation != generation) {
+      generation = rec->generation;
+      sent = 0;
     }
 
-    mutex_enter_blocking(&game_state_mutex);
-    {
-      gs_update_player(gs, move_direction);
-      gs_update_ai(gs);
-      gs_update_ball(gs);
-
-      if (gs->player_score == 6 || gs->ai_score == 6) {
-        gs->reset_score = true;
-        gs->player_score = 0;
-        gs->ai_score = 0;
+    // Frame payload: generation, byte offset (LE32), recording bytes
+    uint32_t used = __atomic_load_n(&rec->used, __ATOMIC_ACQUIRE);
+    while (sent < used && rec->generation == generation) {
+      uint8_t chunk[USB_STREAM_MAX_PAYLOAD];
+      uint32_t len = used - sent;
+      if (len > sizeof(chunk) - 5) {
+        len = sizeof(chunk) - 5;
+      }
+
+      chunk[0] = (uint8_t)generation;
+      chunk[1] = (uint8_t)sent;
+      chunk[2] = (uint8_t)(sent >> 8);
+      chunk[3] = (uint8_t)(sent >> 16);
+      chunk[4] = (uint8_t)(sent >> 24);
+      if (!replay_record_copy(rec, generation, sent, &chunk[5], len)) {
+        break; // A new recording started, pick it up from the start
+      }
+
+      if (!usb_stream_write(USB_STREAM_REPLAY, chunk, (uint16_t)(len + 5))) {
+        break; // No host yet, the recording keeps filling RAM
       }
+      sent += len;
     }
-    mutex_exit(&game_state_mutex);
 
-    vTaskDelayUntil(&xLastWakeTime, xFrequency);
+    vTaskDelay(pdMS_TO_TICKS(mainREPLAY_STREAM_PERIOD_MS));
   }
 }
 
 static void prvGameDrawCanvasTask(void *pvParameters) {
-  struct game_state *gs = pvParameters; // Not used by task
+  (void)pvParameters;
 
   TickType_t xLastWakeTime = xTaskGetTickCount();
   const TickType_t xFrequency = pdMS_TO_TICKS(25);
 
   for (;;) {
-    update_canvas(gs);
+    // Only the canvas is locked, the game state stays with the logic task
+    struct draw_list *list = draw_queue_take(&draw_queue);
+    if (list) {
+      draw_execute(list, vga_get_canvas(), &canvas_lock);
+
+      if (list->latency_probe) {
+        // Breakout's paddle has the same id as the player's entity
+        const struct draw_cmd *move =
+            draw_find_move(list, GAME_ENTITY_PLAYER);
+        latency_drawn(move ? move->y : -1);
+      }
+    }
+
     vTaskDelayUntil(&xLastWakeTime, xFrequency);
   }
 }
@@ -195,7 +458,7 @@ static void prvGameDrawCanvasTask(void *pvParameters) {
 uint32_t process_ir_buffer() {
   static uint32_t last_message = 0;
   if (event_count < 3) {
-    printf("Insufficient events to decode\n");
+    log_write(LOG_IR_TOO_SHORT, 0, 0);
     event_count = 0;
     return 0;
   }
@@ -212,21 +475,21 @@ uint32_t process_ir_buffer() {
       !IR_IN_TIMING_WINDOW(start_pulse_duration, IR_START_PULSE,
                            IR_TIMING_SLACK_US)) {
     event_count = 0;
-    printf("Invalid start sequence. Message discarded.\n");
+    log_write(LOG_IR_BAD_START, 0, 0);
     return 0;
   }
 
   if (IR_IN_TIMING_WINDOW(start_space_duration, IR_REPEAT_SPACE,
                           IR_TIMING_SLACK_US)) {
     event_count = 0;
-    printf("Repeat message");
+    log_write(LOG_IR_REPEAT, 0, 0);
     return last_message;
   }
 
   if (!IR_IN_TIMING_WINDOW(start_space_duration, IR_START_SPACE,
                            IR_TIMING_SLACK_US)) {
     event_count = 0;
-    printf("Invalid start sequence. Message discarded.\n");
+    log_write(LOG_IR_BAD_START, 0, 0);
     return 0;
   }
 
@@ -255,7 +518,7 @@ uint32_t process_ir_buffer() {
       message = (message << 1); // Append logic 0
     } else {
       event_count = 0;
-      printf("Invalid timing (%llu us). Message discarded.\n", delta);
+      log_write(LOG_IR_BAD_TIMING, (uint32_t)delta, 0);
       return 0;
     }
 
@@ -269,16 +532,23 @@ uint32_t process_ir_buffer() {
 }
 
 // GPIO interrupt callback
-void gpio_callback(uint gpio, uint32_t events) {
+void __not_in_flash_func(gpio_callback)(uint gpio, uint32_t events) {
   (void)gpio;
+  uint32_t entered_at = stats_isr_enter(STATS_ISR_GPIO);
+
   if (event_count >= IR_BUFFER_SIZE) {
-    printf("Buffer overflow! Clearing buffer.\n");
+    log_write(LOG_IR_OVERFLOW, 0, 0);
     event_count = 0;
-    return;
+  } else {
+    if (event_count == 0) {
+      latency_edge();
+    }
+    event_buffer[event_count].event_kind = events;
+    event_buffer[event_count].timestamp = time_us_64();
+    event_count++;
   }
-  event_buffer[event_count].event_kind = events;
-  event_buffer[event_count].timestamp = time_us_64();
-  event_count++;
+
+  stats_isr_exit(STATS_ISR_GPIO, entered_at);
 }
 
 // Timer callback to process and decode events after inactivity
@@ -304,7 +574,10 @@ static void vDecodeTimerCallback(TimerHandle_t xTimer) {
       bool addr_valid = ((addr ^ addr_inv) == 0xFF);
 
       if (cmd_valid && addr_valid) {
-        ir_command = command;
+        // Stamped first, the logic task may consume the command as soon as
+        // it is stored and would otherwise pair it with an older stamp
+        latency_decoded();
+        __atomic_store_n(&ir_command, command, __ATOMIC_RELEASE);
       }
     }
   }
@@ -315,92 +588,48 @@ int main(void) {
 
   prvSetupHardware();
 
+  // Nothing else is running yet, and the banked canvas starts out as garbage
+  vga_clear_canvas(vga_get_canvas());
+#if mainRUN_MEMBENCH
+  membench_run(vga_get_canvas());
+#endif
+
   mutex_init(&game_state_mutex);
   mutex_init(&render_sync_mutex);
+  jobs_init();
+  draw_queue_init(&draw_queue);
 
-  multicore_launch_core1(render_loop);
+  xTaskCreateAffinitySet(prvRenderTask, "Render", 2 * configMINIMAL_STACK_SIZE,
+                         NULL, mainRENDER_TASK_PRIORITY,
+                         1 << mainRENDER_TASK_CORE, &xRenderTask);
 
-  uint16_t ball_color =
-      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x42, 0xba, 0xff);
+  current_game->init();
 
-  uint16_t player_color =
-      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xAC, 0x11, 0x22);
-
-  uint16_t AI_color =
-      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xDC, 0x01, 0x29);
-
-  uint16_t bg_color_1 = 0;
-
-  struct pong_rect ball = {
-      .x = 20,
-      .y = 20,
-      .w = 10,
-      .h = 10,
-      .color = ball_color,
-      .v_x = 2,
-      .v_y = 2,
-  };
+  xTaskCreate(prvGameLogicTask, "GameLogic", configMINIMAL_STACK_SIZE, NULL,
+              mainGAME_LOGIC_TASK_PRIORITY, NULL);
 
-  struct pong_rect player = {
-      .x = 20,
-      .x_old = 20,
-      .y = 100,
-      .y_old = 100,
-      .w = 5,
-      .h = 50,
-      .color = player_color,
-      .v_x = 20,
-      .v_y = 5,
-  };
+  xTaskCreate(prvGameDrawCanvasTask, "GameDraw", configMINIMAL_STACK_SIZE, NULL,
+              mainGAME_DRAW_TASK_PRIORITY, NULL);
 
-  struct pong_rect AI = {
-      .x = CANVAS_WIDTH - 25,
-      .x_old = CANVAS_WIDTH - 25,
-      .y = 100,
-      .y_old = 100,
-      .w = 5,
-      .h = 50,
-      .color = AI_color,
-      .v_x = 2,
-      .v_y = 2,
-  };
+  xTaskCreate(prvControlTask, "Control", 2 * configMINIMAL_STACK_SIZE, NULL,
+              mainCONTROL_TASK_PRIORITY, &xControlTask);
 
-  struct pong_rect draw_point_player = {
-      .x = CANVAS_WIDTH / 2 - 25,
-      .y = 20,
-      .w = 5,
-      .h = 10,
-      .color = player_color,
-  };
+  xTaskCreate(prvReplayStreamTask, "ReplayStream", 2 * configMINIMAL_STACK_SIZE,
+              pong_get_recorder(), mainREPLAY_STREAM_TASK_PRIORITY, NULL);
 
-  struct pong_rect draw_point_ai = {
-      .x = CANVAS_WIDTH / 2 + 15,
-      .y = 20,
-      .w = 5,
-      .h = 10,
-      .color = AI_color,
-  };
+  xTaskCreate(stats_task, "Stats", 2 * configMINIMAL_STACK_SIZE, NULL,
+              mainSTATS_TASK_PRIORITY, NULL);
 
-  struct game_state gs = {
-      .bg_color = bg_color_1,
-      .padding_x = 4,
-      .padding_y = 10,
-      .ball = ball,
-      .player = player,
-      .ai = AI,
-      .draw_point_ai = draw_point_ai,
-      .draw_point_player = draw_point_player,
-      .player_score = 0,
-      .ai_score = 0,
-      .canvas_w = CANVAS_WIDTH,
-      .canvas_h = CANVAS_HEIGHT,
-  };
+  xTaskCreate(trace_task, "Trace", 2 * configMINIMAL_STACK_SIZE, NULL,
+              mainTRACE_TASK_PRIORITY, NULL);
 
-  xTaskCreate(prvGameLogicTask, "GameLogic", configMINIMAL_STACK_SIZE, &gs,
-              mainGAME_LOGIC_TASK_PRIORITY, NULL);
+  xTaskCreate(log_task, "Log", 2 * configMINIMAL_STACK_SIZE, NULL,
+              mainLOG_TASK_PRIORITY, NULL);
 
-  xTaskCreate(prvGameDrawCanvasTask, "GameDraw", configMINIMAL_STACK_SIZE, &gs,
-              mainGAME_DRAW_TASK_PRIORITY, NULL);
+#if mainRUN_CAPTURE
+  xTaskCreate(capture_task, "Capture", 2 * configMINIMAL_STACK_SIZE, NULL,
+              mainCAPTURE_TASK_PRIORITY, NULL);
+#endif
 
   TickType_t timer_period = pdMS_TO_TICKS(25);
   xIrDecodeTimer = xTimerCreate((const char *)"IrDecodeTimer", timer_period,
@@ -422,6 +651,9 @@ static void prvSetupHardware(void) {
   gpio_set_irq_enabled_with_callback(IR_GPIO_PIN,
                                      GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE,
                                      true, &gpio_callback);
+
+  // Still on core 0, so the block interrupt stays off the render core
+  audio_init();
 }
 
 static void prvLaunchRTOS() {
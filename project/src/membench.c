@@ -0,0 +1,103 @@
+#include <hardware/sync.h>
+#include <pico/multicore.h>
+#include <pico/stdio_usb.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+
+#include "membench.h"
+#include "vga.h"
+
+static uint16_t *bench_canvas;
+static volatile bool scanout_stop;
+static volatile bool scanout_done;
+static volatile uint32_t scanout_rows;
+
+// Where the scanvideo line buffers would be, in ordinary RAM
+static uint16_t scanout_line[CANVAS_COLUMNS];
+
+// Core 1 stand-in for vga_render_scanline(): one canvas row after another
+// into a line buffer, as fast as the bus allows
+static void __not_in_flash_func(membench_scanout)(void) {
+  uint32_t rows = 0;
+  size_t row = 0;
+
+  while (!scanout_stop) {
+    const uint16_t *src = &bench_canvas[row * CANVAS_WIDTH];
+    for (size_t px = 0; px < CANVAS_WIDTH; px++) {
+      scanout_line[px] = src[px];
+    }
+    __compiler_memory_barrier(); // Every row really gets copied
+
+    rows++;
+    if (++row >= CANVAS_HEIGHT) {
+      row = 0;
+    }
+  }
+
+  scanout_rows = rows;
+  scanout_done = true;
+  __sev();
+}
+
+static void membench_start_scanout(void) {
+  scanout_stop = false;
+  scanout_done = false;
+  multicore_launch_core1(membench_scanout);
+}
+
+static uint32_t membench_stop_scanout(void) {
+  scanout_stop = true;
+  while (!scanout_done) {
+    __wfe();
+  }
+  multicore_reset_core1();
+  return scanout_rows;
+}
+
+static uint32_t membench_fill(void) {
+  uint64_t start = time_us_64();
+  for (uint frame = 0; frame < MEMBENCH_FRAMES; frame++) {
+    vga_fill_rectangle(bench_canvas, 0, 0, CANVAS_WIDTH, CANVAS_HEIGHT,
+                       (uint16_t)frame);
+  }
+  return (uint32_t)(time_us_64() - start);
+}
+
+static void membench_print(const char *test, uint64_t bytes, uint32_t us) {
+  // Bytes per microsecond are MB/s
+  uint32_t centi = us ? (uint32_t)(bytes * 100 / us) : 0;
+  printf("MEMBENCH,%s,%s,%lu.%02lu\n",
+         VGA_BANKED_CANVAS ? "banked" : "striped", test, centi / 100,
+         centi % 100);
+}
+
+void membench_run(uint16_t *canvas) {
+  bench_canvas = canvas;
+  const uint64_t frame_bytes = (uint64_t)CANVAS_SIZE * sizeof(uint16_t);
+  const uint64_t row_bytes = CANVAS_WIDTH * sizeof(uint16_t);
+
+  for (uint waited = 0;
+       !stdio_usb_connected() && waited < MEMBENCH_USB_WAIT_MS; waited += 10) {
+    sleep_ms(10);
+  }
+
+  uint32_t us = membench_fill();
+  membench_print("fill", frame_bytes * MEMBENCH_FRAMES, us);
+
+  uint64_t start = time_us_64();
+  membench_start_scanout();
+  sleep_ms(MEMBENCH_SCANOUT_TIME_MS);
+  uint32_t rows = membench_stop_scanout();
+  membench_print("scanout", rows * row_bytes,
+                 (uint32_t)(time_us_64() - start));
+
+  start = time_us_64();
+  membench_start_scanout();
+  us = membench_fill();
+  rows = membench_stop_scanout();
+  membench_print("fill_shared", frame_bytes * MEMBENCH_FRAMES, us);
+  membench_print("scanout_shared", rows * row_bytes,
+                 (uint32_t)(time_us_64() - start));
+
+  vga_clear_canvas(canvas);
+}
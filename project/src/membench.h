@@ -0,0 +1,20 @@
+#ifndef _MEMBENCH_H_
+#define _MEMBENCH_H_
+
+#include <pico.h>
+
+// Canvas fill and scanout throughput, alone and with both cores at once.
+// Runs before the scheduler starts and uses core 1 directly, so build it
+// once with and once without MAIN_BANKED_CANVAS to compare layouts. Prints
+//
+//   MEMBENCH,<layout>,<test>,<MB/s>
+//
+// for the tests fill, scanout, fill_shared and scanout_shared.
+
+#define MEMBENCH_FRAMES 60          // Full canvas fills per test
+#define MEMBENCH_SCANOUT_TIME_MS 500 // How long the lone scanout test runs
+#define MEMBENCH_USB_WAIT_MS 5000    // For a terminal to attach
+
+void membench_run(uint16_t *canvas);
+
+#endif
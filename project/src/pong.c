@@ -0,0 +1,452 @@
+// Pong on top of the platform independent simulation in game.c
+#include <assert.h>
+#include <pico/stdlib.h>
+#include <pico/unique_id.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arcade.h"
+#include "audio.h"
+#include "draw.h"
+#include "game.h"
+#include "infrared.h"
+#include "link.h"
+#include "lockstep.h"
+#include "log.h"
+#include "pong.h"
+#include "replay.h"
+#include "vga.h"
+
+#define PONG_REPLAY_BUFFER_SIZE (16 * 1024) // Recording kept in RAM
+
+// Set to 1 to print the average game update cost every
+// PONG_TICK_COST_REPORT_PERIOD ticks
+#ifndef PONG_REPORT_TICK_COST
+#define PONG_REPORT_TICK_COST 0
+#endif
+#define PONG_TICK_COST_REPORT_PERIOD 100
+
+#define PONG_SHAKE_TICKS 8 // Screen shake after a point in single-ball play
+#define PONG_SHAKE_PX 3
+#define PONG_NET_DASH 6 // Rows on and off in the dashed centre line
+#define PONG_NET_GAP 4
+
+// pong_draw() records the goals, the net, the view and the points besides
+// one move per entity
+#define PONG_DRAW_FIXED (3 + 1 + 2 * GAME_WINNING_SCORE)
+static_assert(GAME_MAX_ENTITIES + PONG_DRAW_FIXED <= DRAW_LIST_SIZE,
+              "GAME_MAX_BALLS too many for a draw list");
+
+// Set to 1 to play a second board over the link, see lockstep.h. Until one
+// answers, and after a desync, the AI plays as usual.
+#ifndef PONG_LOCKSTEP
+#define PONG_LOCKSTEP 0
+#endif
+
+// Static: the entity store is too big for any task stack
+static struct game_state gs;
+
+// Input recording, restarted with IR key 5 and replayed with IR key 6
+static uint8_t replay_buffer[PONG_REPLAY_BUFFER_SIZE];
+static struct replay_recorder recorder;
+static struct replay_player player;
+static bool replaying = false;
+
+static uint8_t shake_ticks = 0;
+
+#if PONG_LOCKSTEP
+static struct lockstep lockstep;
+static struct lockstep_decoder lockstep_decoder;
+
+// Where the entities were drawn, a rollback leaves no trace of it in gs
+static uint16_t drawn_x[GAME_MAX_ENTITIES];
+static uint16_t drawn_y[GAME_MAX_ENTITIES];
+
+// Two boards powered up together may well read the same timer
+static uint32_t pong_nonce(void) {
+  pico_unique_board_id_t id;
+  pico_get_unique_board_id(&id);
+
+  uint32_t nonce = time_us_32();
+  for (uint i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++) {
+    nonce = (nonce ^ id.id[i]) * 16777619u;
+  }
+  return nonce;
+}
+#endif
+
+struct replay_recorder *pong_get_recorder(void) { return &recorder; }
+
+// Same state on every board for the same seed, lockstep depends on it
+static void pong_setup(uint32_t seed) {
+  uint16_t ball_color =
+      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x42, 0xba, 0xff);
+
+  uint16_t player_color =
+      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xAC, 0x11, 0x22);
+
+  uint16_t AI_color =
+      (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xDC, 0x01, 0x29);
+
+  uint16_t bg_color_1 = 0;
+
+  struct pong_rect ball = {
+      .x = 20,
+      .y = 20,
+      .w = 10,
+      .h = 10,
+      .color = ball_color,
+      .v_x = 2,
+      .v_y = 2,
+  };
+
+  struct pong_rect player_paddle = {
+      .x = 20,
+      .x_old = 20,
+      .y = 100,
+      .y_old = 100,
+      .w = 5,
+      .h = 50,
+      .color = player_color,
+      .v_x = 20,
+      .v_y = 5,
+  };
+
+  struct pong_rect AI = {
+      .x = CANVAS_WIDTH - 25,
+      .x_old = CANVAS_WIDTH - 25,
+      .y = 100,
+      .y_old = 100,
+      .w = 5,
+      .h = 50,
+      .color = AI_color,
+      .v_x = 2,
+      .v_y = 2,
+  };
+
+  struct pong_rect draw_point_player = {
+      .x = CANVAS_WIDTH / 2 - 25,
+      .y = 20,
+      .w = 5,
+      .h = 10,
+      .color = player_color,
+  };
+
+  struct pong_rect draw_point_ai = {
+      .x = CANVAS_WIDTH / 2 + 15,
+      .y = 20,
+      .w = 5,
+      .h = 10,
+      .color = AI_color,
+  };
+
+  gs = (struct game_state){0};
+  gs.bg_color = bg_color_1;
+  gs.padding_x = 4;
+  gs.padding_y = 10;
+  gs.draw_point_ai = draw_point_ai;
+  gs.draw_point_player = draw_point_player;
+  gs.player_score = 0;
+  gs.ai_score = 0;
+  gs.canvas_w = CANVAS_WIDTH;
+  gs.canvas_h = CANVAS_HEIGHT;
+
+  // Order must match GAME_ENTITY_PLAYER, GAME_ENTITY_AI and GAME_ENTITY_BALL
+  gs_add_entity(&gs, &player_paddle);
+  gs_add_entity(&gs, &AI);
+  gs_add_entity(&gs, &ball);
+
+  ai_init(&gs.ai, AI_DIFFICULTY_NORMAL, seed);
+}
+
+static void pong_init(void) {
+  pong_setup(time_us_32());
+
+#if PONG_LOCKSTEP
+  link_init();
+  lockstep_init(&lockstep, pong_nonce());
+#endif
+
+  replaying = false;
+  shake_ticks = 0;
+  if (!recorder.buf) {
+    replay_recorder_init(&recorder, replay_buffer, sizeof(replay_buffer));
+  }
+  replay_record_begin(&recorder, &gs); // Bumps the recording generation
+}
+
+static bool pong_versus(void) {
+#if PONG_LOCKSTEP
+  return lockstep.phase == LOCKSTEP_RUNNING;
+#else
+  return false;
+#endif
+}
+
+// Re-drives the game from the start of the RAM recording
+static void pong_start_replay(void) {
+  replay_record_flush(&recorder);
+  recorder.active = false; // Keep the recording intact while it plays
+
+  if (replay_player_begin(&player, replay_buffer, recorder.used, &gs)) {
+    replaying = true;
+    gs.reset_score = true; // Wipe whatever was on screen
+  } else {
+    replay_record_begin(&recorder, &gs); // Nothing to play, record on
+  }
+}
+
+static uint8_t pong_input(uint8_t command) {
+  switch (command) {
+  case IR_C_UP:
+    return GS_INPUT_UP;
+  case IR_C_DOWN:
+    return GS_INPUT_DOWN;
+  case IR_C_N1:
+    return GS_INPUT_SINGLE_BALL;
+  case IR_C_N2:
+    return GS_INPUT_MULTI_BALL;
+  case IR_C_N5:
+    if (pong_versus()) {
+      return GS_INPUT_NONE; // The recording only has one player's inputs
+    }
+    replaying = false;
+    replay_record_begin(&recorder, &gs); // Fresh recording from here on
+    return GS_INPUT_NONE;
+  case IR_C_N6:
+    if (pong_versus()) {
+      return GS_INPUT_NONE;
+    }
+    pong_start_replay();
+    return GS_INPUT_NONE;
+  case IR_C_N7:
+    return GS_INPUT_AI_EASY;
+  case IR_C_N8:
+    return GS_INPUT_AI_NORMAL;
+  case IR_C_N9:
+    return GS_INPUT_AI_HARD;
+  default:
+    return GS_INPUT_NONE;
+  }
+}
+
+#if PONG_REPORT_TICK_COST
+static void pong_report_tick_cost(uint32_t tick_us, uint16_t entity_count) {
+  static uint32_t total_us = 0;
+  static uint32_t ticks = 0;
+
+  total_us += tick_us;
+  if (++ticks < PONG_TICK_COST_REPORT_PERIOD) {
+    return;
+  }
+
+  printf("Tick cost: %lu us/tick, %lu ns/entity (%u entities)\n",
+         total_us / ticks, (total_us * 1000) / (ticks * entity_count),
+         entity_count);
+  total_us = 0;
+  ticks = 0;
+}
+#endif
+
+#if PONG_LOCKSTEP
+// Sent once the tick has run, so the input it just took goes out with it
+static void pong_lockstep_send(void) {
+  struct lockstep_packet packet;
+  uint8_t bytes[LOCKSTEP_PACKET_SIZE];
+  lockstep_packet(&lockstep, &packet);
+  lockstep_encode(&packet, bytes);
+  link_write(bytes, sizeof(bytes));
+}
+
+// Runs the tick in lockstep with the other board. Returns false while there
+// is no other board, the AI gets the right paddle then.
+static bool pong_lockstep_update(uint8_t input) {
+  struct lockstep_packet packet;
+  int c;
+  while ((c = link_read()) >= 0) {
+    if (lockstep_decode(&lockstep_decoder, (uint8_t)c, &packet)) {
+      lockstep_receive(&lockstep, &packet);
+    }
+  }
+
+  if (lockstep.phase == LOCKSTEP_DESYNC || lockstep.phase == LOCKSTEP_LOST) {
+    if (lockstep.phase == LOCKSTEP_DESYNC) {
+      log_write(LOG_LOCKSTEP_DESYNC, lockstep.desync_tick, 0);
+    } else {
+      log_write(LOG_LOCKSTEP_LOST, lockstep.ticks, 0);
+    }
+    // A new nonce makes the other board start over with us. The AI plays
+    // on in the meantime.
+    lockstep_init(&lockstep, pong_nonce());
+  }
+
+  if (lockstep.phase == LOCKSTEP_READY) {
+    pong_setup(lockstep_seed(&lockstep));
+    gs.reset_score = true; // Wipe the single player game
+    replaying = false;
+    recorder.active = false;
+    lockstep_start(&lockstep, &gs);
+    log_write(LOG_LOCKSTEP_PAIRED, lockstep.side, 0);
+  }
+
+  if (lockstep.phase != LOCKSTEP_RUNNING) {
+    pong_lockstep_send(); // Still looking for, or answering, a peer
+    return false;
+  }
+
+  struct entity_store *es = &gs.entities;
+  uint16_t count = es->count;
+  uint32_t rollbacks = lockstep.rollbacks;
+  memcpy(drawn_x, es->x, count * sizeof(es->x[0]));
+  memcpy(drawn_y, es->y, count * sizeof(es->y[0]));
+
+  if (lockstep_tick(&lockstep, &gs, input) &&
+      lockstep.rollbacks != rollbacks) {
+    // Erase what is on screen, not what the rewritten history says
+    for (uint16_t i = 0; i < MIN(count, es->count); i++) {
+      es->x_old[i] = drawn_x[i];
+      es->y_old[i] = drawn_y[i];
+    }
+  }
+  pong_lockstep_send();
+  return true;
+}
+#endif
+
+// One effect per kind of event in the tick, however many balls raised it
+static void pong_play_events(uint8_t events) {
+  if (events & GS_EVENT_SCORE) {
+    audio_play(AUDIO_SCORE);
+  }
+  if (events & GS_EVENT_PADDLE) {
+    audio_play(AUDIO_PADDLE);
+  }
+  if (events & GS_EVENT_WALL) {
+    audio_play(AUDIO_WALL);
+  }
+}
+
+static void pong_update(uint8_t input) {
+#if PONG_LOCKSTEP
+  if (pong_lockstep_update(input)) {
+    pong_play_events(gs.events);
+    return;
+  }
+#endif
+
+#if PONG_REPORT_TICK_COST
+  uint32_t tick_start = time_us_32();
+#endif
+  if (replaying && !replay_player_next(&player, &gs, &input)) {
+    replaying = false;
+    if (player.desync) {
+      log_write(LOG_REPLAY_DESYNC, player.ticks, player.desync_tick);
+    } else {
+      log_write(LOG_REPLAY_EXACT, player.ticks, 0);
+    }
+    replay_record_begin(&recorder, &gs); // Record the live game again
+  }
+
+  gs_tick(&gs, input);
+  pong_play_events(gs.events);
+
+  if (!replaying) {
+    replay_record_tick(&recorder, &gs, input);
+  }
+#if PONG_REPORT_TICK_COST
+  pong_report_tick_cost(time_us_32() - tick_start, gs.entities.count);
+#endif
+}
+
+static void pong_draw_rect(struct draw_list *list, const pong_rect *rect) {
+  draw_fill(list, rect->x, rect->y, rect->w, rect->h, rect->color);
+}
+
+static void pong_draw(struct draw_list *list) {
+  struct pong_rect player_goal = {
+      .x = 20,
+      .y = 0,
+      .w = 1,
+      .h = CANVAS_HEIGHT,
+      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x00, 0x33, 0x00),
+  };
+
+  struct pong_rect mid_line = {
+      .x = CANVAS_WIDTH / 2 - 1,
+      .y = 0,
+      .w = 2,
+      .h = CANVAS_HEIGHT,
+      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0xaa, 0xaa, 0xaa),
+  };
+
+  struct pong_rect ai_goal = {
+      .x = CANVAS_WIDTH - 20,
+      .y = 0,
+      .w = 1,
+      .h = CANVAS_HEIGHT,
+      .color = (uint16_t)PICO_SCANVIDEO_PIXEL_FROM_RGB5(0x33, 0x00, 0x00),
+  };
+
+  // Every object is recorded every tick anyway, nothing to catch up on
+  list->lost = false;
+
+  pong_draw_rect(list, &player_goal);
+  draw_net(list, mid_line.x, mid_line.y, mid_line.w, mid_line.h,
+           PONG_NET_DASH, PONG_NET_GAP, mid_line.color);
+  pong_draw_rect(list, &ai_goal);
+
+  const struct entity_store *es = &gs.entities;
+  // Render all entities
+  for (uint16_t i = 0; i < GAME_ENTITY_BALL; i++) {
+    draw_move(list, i, es->x_old[i], es->y_old[i], es->x[i], es->y[i],
+              es->w[i], es->h[i], es->color[i]);
+  }
+  for (uint16_t i = GAME_ENTITY_BALL; i < es->count; i++) {
+    draw_move_round(list, i, es->x_old[i], es->y_old[i], es->x[i], es->y[i],
+                    es->w[i], es->h[i], (uint8_t)(es->w[i] / 2), es->color[i]);
+  }
+
+  // Shake the screen for a moment after a point. A multi-ball field scores
+  // far too often for that.
+  if ((gs.events & GS_EVENT_SCORE) && es->count == GAME_ENTITY_BALL + 1) {
+    shake_ticks = PONG_SHAKE_TICKS;
+  }
+  if (shake_ticks) {
+    shake_ticks--;
+    int16_t shake = (shake_ticks & 1) ? PONG_SHAKE_PX : -PONG_SHAKE_PX;
+    draw_view(list, 0, 0, 0, shake_ticks ? shake : 0);
+  }
+
+  if (gs.reset_score) {
+    draw_clear(list);
+
+    gs.reset_score = false;
+    return;
+  }
+
+  for (uint i = 0; i < gs.ai_score; i++) {
+    int prev_pos = gs.draw_point_ai.x;
+    gs.draw_point_ai.x += i * 10;
+
+    pong_draw_rect(list, &gs.draw_point_ai);
+
+    gs.draw_point_ai.x = prev_pos;
+  }
+
+  for (uint i = 0; i < gs.player_score; i++) {
+    int prev_pos = gs.draw_point_player.x;
+    gs.draw_point_player.x -= i * 10 - gs.draw_point_player.w;
+
+    pong_draw_rect(list, &gs.draw_point_player);
+
+    gs.draw_point_player.x = prev_pos;
+  }
+}
+
+const struct arcade_game pong_game = {
+    .name = "Pong",
+    .init = pong_init,
+    .input = pong_input,
+    .update = pong_update,
+    .draw = pong_draw,
+};
@@ -0,0 +1,9 @@
+#ifndef _PONG_H_
+#define _PONG_H_
+
+#include "replay.h"
+
+// The recording of the current Pong session, streamed out by main.c
+struct replay_recorder *pong_get_recorder(void);
+
+#endif
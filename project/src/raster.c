@@ -0,0 +1,245 @@
+#include "raster.h"
+
+static inline void raster_fill(uint16_t *dest, int count, uint16_t color) {
+  for (int i = 0; i < count; i++) {
+    dest[i] = color;
+  }
+}
+
+void __not_in_flash_func(raster_span)(const struct raster_target *target,
+                                      int x0, int x1, int y, uint16_t color) {
+  if (y < 0 || y >= target->height) {
+    return;
+  }
+  if (x0 < 0) {
+    x0 = 0;
+  }
+  if (x1 > target->width) {
+    x1 = target->width;
+  }
+  if (x0 >= x1) {
+    return;
+  }
+
+  raster_fill(target->row(target->canvas, (size_t)y) + x0, x1 - x0, color);
+}
+
+// False if nothing of the box can be on the canvas
+static bool raster_visible(const struct raster_target *target, int x, int y,
+                           int w, int h) {
+  return w > 0 && h > 0 && x < target->width && y < target->height &&
+         x + w > 0 && y + h > 0;
+}
+
+void __not_in_flash_func(raster_line)(const struct raster_target *target,
+                                      int x0, int y0, int x1, int y1,
+                                      uint16_t color) {
+  int left = MIN(x0, x1);
+  int top = MIN(y0, y1);
+  if (!raster_visible(target, left, top, MAX(x0, x1) - left + 1,
+                      MAX(y0, y1) - top + 1)) {
+    return;
+  }
+
+  int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+  int sx = x0 < x1 ? 1 : -1;
+  int sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+
+  // Pixels are collected until the line leaves the row, then written as one
+  int run = x0;
+  while (x0 != x1 || y0 != y1) {
+    int e2 = 2 * err;
+    int x = x0;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      raster_span(target, MIN(run, x), MAX(run, x) + 1, y0, color);
+      y0 += sy;
+      run = x0;
+    }
+  }
+  raster_span(target, MIN(run, x0), MAX(run, x0) + 1, y0, color);
+}
+
+void __not_in_flash_func(raster_fill_circle)(
+    const struct raster_target *target, int cx, int cy, int r,
+    uint16_t color) {
+  if (r < 0 || !raster_visible(target, cx - r, cy - r, 2 * r + 1, 2 * r + 1)) {
+    return;
+  }
+
+  // One octant is walked, the rows it touches are mirrored to the rest. The
+  // rows far from the centre are only written once their width is final.
+  int x = r;
+  int y = 0;
+  int err = 1 - r;
+  while (x >= y) {
+    raster_span(target, cx - x, cx + x + 1, cy + y, color);
+    if (y != 0) {
+      raster_span(target, cx - x, cx + x + 1, cy - y, color);
+    }
+
+    if (err < 0) {
+      err += 2 * y + 3;
+    } else {
+      if (x != y) {
+        raster_span(target, cx - y, cx + y + 1, cy + x, color);
+        raster_span(target, cx - y, cx + y + 1, cy - x, color);
+      }
+      err += 2 * (y - x) + 5;
+      x--;
+    }
+    y++;
+  }
+}
+
+// Pixels cut off the start of corner row i (0 = outermost) for radius r.
+// A pixel stays if its centre is inside the corner circle, the cut only
+// grows towards the edge so one walk fills the table.
+static void raster_round_insets(uint8_t *inset, int r) {
+  int cut = 0;
+  for (int i = r - 1; i >= 0; i--) {
+    int dy = 2 * (r - i) - 1;
+    while (cut < r) {
+      int dx = 2 * (r - cut) - 1;
+      if (dx * dx + dy * dy <= 4 * r * r) {
+        break;
+      }
+      cut++;
+    }
+    inset[i] = (uint8_t)cut;
+  }
+}
+
+static int raster_clamp_radius(int w, int h, int r) {
+  r = MIN(r, MIN(w, h) / 2);
+  return MAX(0, MIN(r, RASTER_MAX_RADIUS));
+}
+
+// Pixels cut off both ends of a rounded rectangle's row, counted from its top
+static inline int raster_round_cut(const uint8_t *inset, int h, int r,
+                                   int row) {
+  if (row < r) {
+    return inset[row];
+  }
+  if (row >= h - r) {
+    return inset[h - 1 - row];
+  }
+  return 0;
+}
+
+void __not_in_flash_func(raster_fill_round_rect)(
+    const struct raster_target *target, int x, int y, int w, int h, int r,
+    uint16_t color) {
+  if (!raster_visible(target, x, y, w, h)) {
+    return;
+  }
+
+  uint8_t inset[RASTER_MAX_RADIUS];
+  r = raster_clamp_radius(w, h, r);
+  raster_round_insets(inset, r);
+
+  int first = MAX(0, -y);
+  int last = MIN(h, target->height - y);
+  for (int row = first; row < last; row++) {
+    int cut = raster_round_cut(inset, h, r, row);
+    raster_span(target, x + cut, x + w - cut, y + row, color);
+  }
+}
+
+void __not_in_flash_func(raster_move_round_rect)(
+    const struct raster_target *target, int x_old, int y_old, int x, int y,
+    int w, int h, int r, uint16_t color) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  uint8_t inset[RASTER_MAX_RADIUS];
+  r = raster_clamp_radius(w, h, r);
+  raster_round_insets(inset, r);
+
+  int first = MAX(0, MIN(y_old, y));
+  int last = MIN((int)target->height, MAX(y_old, y) + h);
+  for (int row = first; row < last; row++) {
+    bool in_old = row >= y_old && row < y_old + h;
+    bool in_new = row >= y && row < y + h;
+
+    int new_x0 = 0;
+    int new_x1 = 0;
+    if (in_new) {
+      int cut = raster_round_cut(inset, h, r, row - y);
+      new_x0 = x + cut;
+      new_x1 = x + w - cut;
+    }
+
+    // Whatever of the old span sticks out on either side of the new one
+    if (in_old) {
+      int cut = raster_round_cut(inset, h, r, row - y_old);
+      int old_x0 = x_old + cut;
+      int old_x1 = x_old + w - cut;
+      if (!in_new) {
+        raster_span(target, old_x0, old_x1, row, 0);
+      } else {
+        raster_span(target, old_x0, MIN(old_x1, new_x0), row, 0);
+        raster_span(target, MAX(old_x0, new_x1), old_x1, row, 0);
+      }
+    }
+
+    if (in_new) {
+      raster_span(target, new_x0, new_x1, row, color);
+    }
+  }
+}
+
+void raster_rect_border(const struct raster_target *target, int x, int y,
+                        int w, int h, uint16_t color) {
+  if (!raster_visible(target, x, y, w, h)) {
+    return;
+  }
+
+  raster_span(target, x, x + w, y, color);
+  raster_span(target, x, x + w, y + h - 1, color);
+
+  int first = MAX(y + 1, 0);
+  int last = MIN(y + h - 1, (int)target->height);
+  for (int row = first; row < last; row++) {
+    uint16_t *dest = target->row(target->canvas, (size_t)row);
+    if (x >= 0) {
+      dest[x] = color;
+    }
+    if (x + w - 1 < target->width) {
+      dest[x + w - 1] = color;
+    }
+  }
+}
+
+void __not_in_flash_func(raster_dashed_vline)(
+    const struct raster_target *target, int x, int y, int w, int h, int dash,
+    int gap, uint16_t color) {
+  if (dash <= 0 || !raster_visible(target, x, y, w, h)) {
+    return;
+  }
+
+  // Clipped once here, the rows below are filled without further checks
+  int x0 = MAX(x, 0);
+  int x1 = MIN(x + w, (int)target->width);
+  int first = MAX(0, -y);
+  int last = MIN(h, target->height - y);
+  int period = dash + MAX(gap, 0);
+
+  int phase = first % period;
+  for (int row = first; row < last; row++) {
+    if (phase < dash) {
+      raster_fill(target->row(target->canvas, (size_t)(y + row)) + x0,
+                  x1 - x0, color);
+    }
+    if (++phase == period) {
+      phase = 0;
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef _RASTER_H_
+#define _RASTER_H_
+
+#include <pico.h>
+
+// Shape rasterizer built on horizontal spans. Every shape is broken into
+// runs of one row, each run is clipped once and then filled without any
+// per-pixel test, so a round ball costs about what a rectangle does. Nothing
+// here knows about scanvideo, the host benchmark runs the same code.
+
+#define RASTER_MAX_RADIUS 32 // Corner radius limit for rounded rectangles
+
+// Where the spans land. Rows are fetched through `row` so the device can
+// route them through vga_canvas_row(), the host just indexes an array.
+struct raster_target {
+  uint16_t *canvas;
+  uint16_t *(*row)(uint16_t *canvas, size_t y); // Writable row y
+  uint16_t width;
+  uint16_t height;
+};
+
+// Pixels [x0, x1) of row y
+void raster_span(const struct raster_target *target, int x0, int x1, int y,
+                 uint16_t color);
+
+// Bresenham line, both ends included. Runs of a flat line are one span.
+void raster_line(const struct raster_target *target, int x0, int y0, int x1,
+                 int y1, uint16_t color);
+
+// Midpoint circle around (cx, cy), 2 * r + 1 pixels across
+void raster_fill_circle(const struct raster_target *target, int cx, int cy,
+                        int r, uint16_t color);
+
+// Corners rounded with radius r, a square with r = w / 2 is a disc
+void raster_fill_round_rect(const struct raster_target *target, int x, int y,
+                            int w, int h, int r, uint16_t color);
+
+// Rounded rectangle erased to black at its old place and drawn at the new
+// one. Only the pixels the new shape does not cover are erased.
+void raster_move_round_rect(const struct raster_target *target, int x_old,
+                            int y_old, int x, int y, int w, int h, int r,
+                            uint16_t color);
+
+void raster_rect_border(const struct raster_target *target, int x, int y,
+                        int w, int h, uint16_t color);
+
+// Vertical line w pixels wide, dash rows on and gap rows off
+void raster_dashed_vline(const struct raster_target *target, int x, int y,
+                         int w, int h, int dash, int gap, uint16_t color);
+
+#endif
@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "replay.h"
+
+static bool recorder_put(struct replay_recorder *rec, const void *data,
+                         uint32_t len) {
+  uint32_t used = rec->used;
+  if (len > rec->size - used) {
+    rec->active = false; // Out of room: keep what we have and stop
+    return false;
+  }
+
+  memcpy(&rec->buf[used], data, len);
+  // Publish only complete bytes to the streaming side
+  __atomic_store_n(&rec->used, used + len, __ATOMIC_RELEASE);
+  return true;
+}
+
+void replay_recorder_init(struct replay_recorder *rec, uint8_t *buf,
+                          uint32_t size) {
+  rec->buf = buf;
+  rec->size = size;
+  rec->used = 0;
+  rec->generation = 0;
+  rec->ticks = 0;
+  rec->run_input = 0;
+  rec->run_length = 0;
+  rec->active = false;
+  rec->lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+bool replay_record_begin(struct replay_recorder *rec,
+                         const struct game_state *gs) {
+  struct replay_header header = {
+      .magic = REPLAY_MAGIC,
+      .version = REPLAY_VERSION,
+      .state_size = sizeof(struct game_state),
+  };
+
+  // A copy in replay_record_copy() sees either the old recording or the
+  // new generation, never the old generation over rewritten bytes
+  uint32_t irq = spin_lock_blocking(rec->lock);
+  rec->used = 0;
+  rec->generation++;
+  rec->ticks = 0;
+  rec->run_length = 0;
+  rec->active = true;
+
+  bool ok = recorder_put(rec, &header, sizeof(header)) &&
+            recorder_put(rec, gs, sizeof(*gs));
+  spin_unlock(rec->lock, irq);
+  return ok;
+}
+
+bool replay_record_copy(struct replay_recorder *rec, uint32_t generation,
+                        uint32_t offset, uint8_t *dst, uint32_t len) {
+  uint32_t irq = spin_lock_blocking(rec->lock);
+  bool current = rec->generation == generation &&
+                 offset + len <= __atomic_load_n(&rec->used, __ATOMIC_ACQUIRE);
+  if (current) {
+    memcpy(dst, &rec->buf[offset], len);
+  }
+  spin_unlock(rec->lock, irq);
+  return current;
+}
+
+void replay_record_flush(struct replay_recorder *rec) {
+  if (!rec->active || rec->run_length == 0) {
+    return;
+  }
+
+  uint8_t run = (uint8_t)((rec->run_input << 4) | (rec->run_length - 1));
+  rec->run_length = 0;
+  recorder_put(rec, &run, 1);
+}
+
+void replay_record_tick(struct replay_recorder *rec,
+                        const struct game_state *gs, uint8_t input) {
+  if (!rec->active) {
+    return;
+  }
+
+  // Extend the current run when possible, that is the common path
+  if (rec->run_length && rec->run_input == input &&
+      rec->run_length < REPLAY_RUN_MAX) {
+    rec->run_length++;
+  } else {
+    replay_record_flush(rec);
+    rec->run_input = input;
+    rec->run_length = 1;
+  }
+
+  if (++rec->ticks % REPLAY_CHECKPOINT_TICKS == 0) {
+    replay_record_flush(rec);
+
+    uint32_t hash = gs_hash(gs);
+    uint8_t checkpoint[5] = {
+        REPLAY_CHECKPOINT << 4,   (uint8_t)hash,
+        (uint8_t)(hash >> 8),     (uint8_t)(hash >> 16),
+        (uint8_t)(hash >> 24),
+    };
+    recorder_put(rec, checkpoint, sizeof(checkpoint));
+  }
+}
+
+bool replay_player_begin(struct replay_player *player, const uint8_t *data,
+                         uint32_t len, struct game_state *gs) {
+  struct replay_header header;
+
+  if (len < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+
+  if (header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION ||
+      header.state_size != sizeof(*gs) ||
+      len < sizeof(header) + header.state_size) {
+    return false;
+  }
+
+  memcpy(gs, data + sizeof(header), sizeof(*gs));
+
+  player->data = data;
+  player->len = len;
+  player->pos = sizeof(header) + header.state_size;
+  player->ticks = 0;
+  player->run_input = 0;
+  player->run_left = 0;
+  player->desync = false;
+  player->desync_tick = 0;
+  return true;
+}
+
+bool replay_player_next(struct replay_player *player,
+                        const struct game_state *gs, uint8_t *input) {
+  while (player->run_left == 0) {
+    if (player->pos >= player->len) {
+      return false;
+    }
+
+    uint8_t run = player->data[player->pos++];
+    if ((run >> 4) != REPLAY_CHECKPOINT) {
+      player->run_input = run >> 4;
+      player->run_left = (run & 0xF) + 1;
+      continue;
+    }
+
+    if (player->len - player->pos < 4) {
+      return false; // Truncated checkpoint at the end of a stream
+    }
+
+    const uint8_t *p = &player->data[player->pos];
+    uint32_t hash = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    player->pos += 4;
+
+    if (!player->desync && hash != gs_hash(gs)) {
+      player->desync = true;
+      player->desync_tick = player->ticks;
+    }
+  }
+
+  player->run_left--;
+  player->ticks++;
+  *input = player->run_input;
+  return true;
+}
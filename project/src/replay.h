@@ -0,0 +1,85 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <hardware/sync.h>
+#include <pico.h>
+
+#include "game.h"
+
+// -------- Format --------
+//
+// header | struct game_state snapshot | input runs ...
+//
+// Each run is one byte, (input << 4) | (ticks - 1). A byte whose input nibble
+// is REPLAY_CHECKPOINT is followed by the little-endian gs_hash() of the state
+// after the ticks recorded so far, so a replay can prove it is bit-exact.
+
+#define REPLAY_MAGIC 0x4c505250u // "PRPL"
+#define REPLAY_VERSION 1
+#define REPLAY_RUN_MAX 16
+#define REPLAY_CHECKPOINT 0xF
+#define REPLAY_CHECKPOINT_TICKS 256
+
+// -------- Format --------
+
+struct replay_header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t state_size; // sizeof(struct game_state) of the recording side
+};
+
+struct replay_recorder {
+  uint8_t *buf;
+  uint32_t size;
+  volatile uint32_t used;       // Bytes complete and safe to stream out
+  volatile uint32_t generation; // Bumped by every replay_record_begin()
+  spin_lock_t *lock;            // Held while the start of buf is rewritten
+
+  uint32_t ticks;
+  uint8_t run_input;
+  uint8_t run_length;
+  bool active;
+};
+
+struct replay_player {
+  const uint8_t *data;
+  uint32_t len;
+  uint32_t pos;
+
+  uint32_t ticks;
+  uint8_t run_input;
+  uint8_t run_left;
+
+  bool desync;          // A checkpoint hash did not match
+  uint32_t desync_tick; // First tick at which it did not
+};
+
+void replay_recorder_init(struct replay_recorder *rec, uint8_t *buf,
+                          uint32_t size);
+
+// Starts a new recording from the current state, false if it cannot fit
+bool replay_record_begin(struct replay_recorder *rec,
+                         const struct game_state *gs);
+
+// Logs the input of one tick, call right after gs_tick() with the same input
+void replay_record_tick(struct replay_recorder *rec,
+                        const struct game_state *gs, uint8_t input);
+
+// Pushes out the pending run so the buffer holds every recorded tick
+void replay_record_flush(struct replay_recorder *rec);
+
+// Copies len published bytes from offset for another task to send, false
+// if a recording other than `generation` was started in the meantime
+bool replay_record_copy(struct replay_recorder *rec, uint32_t generation,
+                        uint32_t offset, uint8_t *dst, uint32_t len);
+
+// Restores the recorded snapshot into gs, false if the data is not usable
+bool replay_player_begin(struct replay_player *player, const uint8_t *data,
+                         uint32_t len, struct game_state *gs);
+
+// Fetches the input for the next tick, false once the recording ends. gs is
+// checked against any checkpoint reached on the way.
+bool replay_player_next(struct replay_player *player,
+                        const struct game_state *gs, uint8_t *input);
+
+#endif
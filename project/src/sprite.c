@@ -0,0 +1,18 @@
+#include "sprite.h"
+
+void __not_in_flash_func(sprite_draw)(const struct raster_target *target,
+                                      const struct sprite *sprite, int x,
+                                      int y) {
+  const uint8_t *at = sprite->spans;
+
+  for (int row = 0; row < sprite->height; row++) {
+    uint count = *at++;
+    int x0 = x;
+    for (uint i = 0; i < count; i++, at += 3) {
+      x0 += at[0];
+      int x1 = x0 + at[1];
+      raster_span(target, x0, x1, y + row, sprite->palette[at[2]]);
+      x0 = x1;
+    }
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef _SPRITE_H_
+#define _SPRITE_H_
+
+#include <pico.h>
+
+#include "raster.h"
+
+// Palette-indexed sprites made from PNGs at build time by
+// tools/png2sprite.py, which lists them in the generated assets.h. Rows are
+// stored as opaque spans, so drawing one is a raster_span() per run of a
+// colour and transparent pixels are never touched.
+
+struct sprite {
+  uint16_t width;
+  uint16_t height;
+  uint16_t colors;
+  const uint16_t *palette; // Canvas pixels
+  // Per row: span count, then skip, length and palette index per span
+  const uint8_t *spans;
+};
+
+// Top left corner at (x, y), clipped to the target
+void sprite_draw(const struct raster_target *target,
+                 const struct sprite *sprite, int x, int y);
+
+#endif
@@ -0,0 +1,149 @@
+#include <FreeRTOS.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+#include <task.h>
+
+#include "latency.h"
+#include "stats.h"
+#include "vga.h"
+
+static const char *const isr_names[STATS_ISR_COUNT] = {
+    [STATS_ISR_GPIO] = "gpio",
+    [STATS_ISR_AUDIO] = "audio",
+};
+
+static volatile uint32_t isr_time_us[STATS_ISR_COUNT];
+static volatile uint32_t isr_count[STATS_ISR_COUNT];
+
+void __not_in_flash_func(stats_isr_exit)(enum stats_isr isr,
+                                         uint32_t entered_at) {
+  isr_time_us[isr] += time_us_32() - entered_at;
+  isr_count[isr]++;
+  trace_record(TRACE_ISR_EXIT, (uint8_t)isr, 0);
+}
+
+// The core a task is pinned to, or "*" when it may run on either
+static const char *core_name(UBaseType_t affinity) {
+  switch (affinity) {
+  case 1 << 0:
+    return "0";
+  case 1 << 1:
+    return "1";
+  default:
+    return "*";
+  }
+}
+
+#if STATS_XIP_AUDIT
+static volatile uint32_t xip_frames;
+static volatile uint32_t xip_worst_frame;  // Misses, reset by every report
+static volatile uint32_t xip_window_total; // Misses while generating lines
+static uint32_t xip_frame_start;
+
+void __not_in_flash_func(stats_xip_frame)(void) {
+  uint32_t misses = stats_xip_misses();
+  uint32_t frame = misses - xip_frame_start;
+  xip_frame_start = misses;
+
+  if (xip_frames++ > 0 && frame > xip_worst_frame) {
+    xip_worst_frame = frame;
+  }
+}
+
+void __not_in_flash_func(stats_xip_window_end)(uint32_t begin) {
+  xip_window_total += stats_xip_misses() - begin;
+}
+
+static void stats_xip_report(uint32_t uptime_ms) {
+  static uint32_t last_frames, last_hit, last_acc, last_window;
+
+  uint32_t frames = xip_frames - last_frames;
+  uint32_t hit = xip_ctrl_hw->ctr_hit;
+  uint32_t acc = xip_ctrl_hw->ctr_acc;
+  uint32_t window = xip_window_total;
+  uint32_t accesses = acc - last_acc;
+  uint32_t misses = accesses - (hit - last_hit);
+
+  printf("XIP,%lu,%lu,%lu,%lu,%lu,%lu\n", uptime_ms, frames,
+         accesses ? (uint32_t)((uint64_t)(hit - last_hit) * 1000 / accesses)
+                  : 1000,
+         frames ? misses / frames : 0, xip_worst_frame, window - last_window);
+
+  last_frames += frames;
+  last_hit = hit;
+  last_acc = acc;
+  last_window = window;
+  xip_worst_frame = 0;
+}
+#endif
+
+void stats_task(void *pvParameters) {
+  (void)pvParameters;
+
+  static TaskStatus_t status[STATS_MAX_TASKS];
+  static configRUN_TIME_COUNTER_TYPE last_runtime[STATS_MAX_TASKS];
+  static uint32_t last_isr_time_us[STATS_ISR_COUNT];
+  static uint32_t last_isr_count[STATS_ISR_COUNT];
+  static struct vga_scanout_counts last_scanout;
+
+  configRUN_TIME_COUNTER_TYPE last_total = portGET_RUN_TIME_COUNTER_VALUE();
+  TickType_t xLastWakeTime = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(STATS_REPORT_PERIOD_MS));
+
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t count = uxTaskGetSystemState(status, STATS_MAX_TASKS, &total);
+    configRUN_TIME_COUNTER_TYPE elapsed = total - last_total;
+    last_total = total;
+
+    if (elapsed == 0) {
+      continue;
+    }
+
+    uint32_t uptime_ms = to_ms_since_boot(get_absolute_time());
+
+    for (UBaseType_t i = 0; i < count; i++) {
+      // Task numbers are handed out in creation order, so they index the
+      // per-task history directly
+      UBaseType_t slot = status[i].xTaskNumber % STATS_MAX_TASKS;
+      configRUN_TIME_COUNTER_TYPE ran =
+          status[i].ulRunTimeCounter - last_runtime[slot];
+      last_runtime[slot] = status[i].ulRunTimeCounter;
+
+      printf("STAT,%lu,%s,%s,%lu,%lu\n", uptime_ms, status[i].pcTaskName,
+             core_name(status[i].uxCoreAffinityMask),
+             (uint32_t)(ran * 1000 / elapsed),
+             (uint32_t)status[i].usStackHighWaterMark);
+    }
+
+    for (uint isr = 0; isr < STATS_ISR_COUNT; isr++) {
+      uint32_t time_us = isr_time_us[isr];
+      uint32_t calls = isr_count[isr];
+
+      printf("ISR,%lu,%s,%lu,%lu\n", uptime_ms, isr_names[isr],
+             (uint32_t)((uint64_t)(time_us - last_isr_time_us[isr]) * 1000 /
+                        elapsed),
+             calls - last_isr_count[isr]);
+
+      last_isr_time_us[isr] = time_us;
+      last_isr_count[isr] = calls;
+    }
+
+    struct vga_scanout_counts scanout;
+    vga_get_scanout_counts(&scanout);
+    printf("SCANOUT,%lu,%lu,%lu,%lu,%lu,%lu\n", uptime_ms,
+           scanout.copied - last_scanout.copied,
+           scanout.reused - last_scanout.reused,
+           scanout.blank - last_scanout.blank,
+           scanout.layered - last_scanout.layered,
+           scanout.encoded - last_scanout.encoded);
+    last_scanout = scanout;
+
+    latency_report(uptime_ms);
+
+#if STATS_XIP_AUDIT
+    stats_xip_report(uptime_ms);
+#endif
+  }
+}
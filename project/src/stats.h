@@ -0,0 +1,75 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <hardware/structs/xip_ctrl.h>
+#include <hardware/timer.h>
+#include <pico.h>
+
+#include "trace.h"
+
+#define STATS_REPORT_PERIOD_MS 1000
+#define STATS_MAX_TASKS 16
+
+// Set to 1 to count XIP cache hits and misses per frame and inside the
+// scanline generation window, reported as an extra XIP record
+#ifndef STATS_XIP_AUDIT
+#define STATS_XIP_AUDIT 0
+#endif
+
+// -------- ISR accounting --------
+
+enum stats_isr {
+  STATS_ISR_GPIO,  // IR receiver edges
+  STATS_ISR_AUDIO, // Mixing the next sample block, see audio.h
+  STATS_ISR_COUNT,
+};
+
+// Bracket an interrupt handler, the time in between is charged to `isr` and
+// both ends land in the trace ring
+static inline uint32_t stats_isr_enter(enum stats_isr isr) {
+  trace_record(TRACE_ISR_ENTER, (uint8_t)isr, 0);
+  return time_us_32();
+}
+void stats_isr_exit(enum stats_isr isr, uint32_t entered_at);
+
+// -------- ISR accounting --------
+
+// -------- XIP cache audit --------
+
+// The cache counters are shared by both cores, so every figure is an upper
+// bound for the code being measured. A window that never misses proves that
+// code never waited on flash.
+static inline uint32_t stats_xip_misses(void) {
+  return xip_ctrl_hw->ctr_acc - xip_ctrl_hw->ctr_hit;
+}
+
+#if STATS_XIP_AUDIT
+void stats_xip_frame(void);
+static inline uint32_t stats_xip_window_begin(void) {
+  return stats_xip_misses();
+}
+void stats_xip_window_end(uint32_t begin);
+#else
+static inline void stats_xip_frame(void) {}
+static inline uint32_t stats_xip_window_begin(void) { return 0; }
+static inline void stats_xip_window_end(uint32_t begin) { (void)begin; }
+#endif
+
+// -------- XIP cache audit --------
+
+// FreeRTOS task that prints one CSV record per task and per ISR every
+// STATS_REPORT_PERIOD_MS:
+//
+//   STAT,<uptime ms>,<task>,<core>,<cpu per mille>,<stack high water words>
+//   ISR,<uptime ms>,<isr>,<cpu per mille>,<count>
+//   SCANOUT,<uptime ms>,<lines copied>,<lines reused>,<blank lines>,
+//       <lines over the background layer>,<lines encoded again>
+//   XIP,<uptime ms>,<frames>,<hit per mille>,<misses per frame>,
+//       <worst frame misses>,<scanline window misses>   (STATS_XIP_AUDIT)
+//   LATENCY,... and LATENCY_HIST,...                      (see latency.h)
+//
+// CPU figures are per mille of one core, so the tasks sum to about 2000.
+// <core> is the pinned core or * for tasks free to run on either.
+void stats_task(void *pvParameters);
+
+#endif
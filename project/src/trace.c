@@ -0,0 +1,123 @@
+#include <FreeRTOS.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <pico/stdio_usb.h>
+#include <pico/stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "trace.h"
+#include "usb_stream.h"
+
+#define TRACE_CORES 2
+#define TRACE_EVENTS_PER_FRAME                                                 \
+  ((USB_STREAM_MAX_PAYLOAD - 2) / sizeof(struct trace_event))
+
+struct trace_ring {
+  struct trace_event events[TRACE_RING_EVENTS];
+  uint32_t head; // Total events ever recorded, wraps the ring
+};
+
+static struct trace_ring rings[TRACE_CORES];
+static volatile bool frozen = false; // Set while the rings are being dumped
+
+void __not_in_flash_func(trace_record)(uint8_t type, uint8_t arg8,
+                                       uint16_t arg16) {
+  // A task is only switched out, or moved to the other core, from an
+  // interrupt. With them masked this core's ring has no other writer.
+  uint32_t irq = save_and_disable_interrupts();
+  struct trace_ring *ring = &rings[get_core_num()];
+
+  // Checked with interrupts masked, so a dump that starts on this core
+  // cannot come in between. One on the other core still can, but it sends
+  // the task list first, long after this store has landed.
+  if (frozen) {
+    restore_interrupts(irq);
+    return;
+  }
+
+  struct trace_event *event =
+      &ring->events[ring->head++ & (TRACE_RING_EVENTS - 1)];
+  event->timestamp = time_us_32();
+  event->type = type;
+  event->arg8 = arg8;
+  event->arg16 = arg16;
+  restore_interrupts(irq);
+}
+
+void __not_in_flash_func(trace_task_switched_in)(unsigned int task_number) {
+  trace_record(TRACE_TASK_IN, 0, (uint16_t)task_number);
+}
+
+void __not_in_flash_func(trace_task_switched_out)(unsigned int task_number) {
+  trace_record(TRACE_TASK_OUT, 0, (uint16_t)task_number);
+}
+
+static void trace_dump_tasks(void) {
+  static TaskStatus_t status[16];
+  UBaseType_t count = uxTaskGetSystemState(status, 16, NULL);
+
+  for (UBaseType_t i = 0; i < count; i++) {
+    uint8_t record[3 + configMAX_TASK_NAME_LEN];
+    size_t len = strlen(status[i].pcTaskName);
+    if (len > configMAX_TASK_NAME_LEN) {
+      len = configMAX_TASK_NAME_LEN;
+    }
+
+    record[0] = TRACE_RECORD_TASK;
+    record[1] = (uint8_t)status[i].xTaskNumber;
+    record[2] = (uint8_t)(status[i].xTaskNumber >> 8);
+    memcpy(&record[3], status[i].pcTaskName, len);
+    usb_stream_write(USB_STREAM_TRACE, record, (uint16_t)(3 + len));
+  }
+}
+
+static void trace_dump_ring(uint core) {
+  const struct trace_ring *ring = &rings[core];
+  uint8_t record[2 + TRACE_EVENTS_PER_FRAME * sizeof(struct trace_event)];
+
+  uint32_t head = ring->head;
+  uint32_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+
+  // Oldest first, so the host sees timestamps in order
+  for (uint32_t i = first; i < head;) {
+    uint32_t count = head - i;
+    if (count > TRACE_EVENTS_PER_FRAME) {
+      count = TRACE_EVENTS_PER_FRAME;
+    }
+
+    record[0] = TRACE_RECORD_EVENTS;
+    record[1] = (uint8_t)core;
+    for (uint32_t n = 0; n < count; n++, i++) {
+      memcpy(&record[2 + n * sizeof(struct trace_event)],
+             &ring->events[i & (TRACE_RING_EVENTS - 1)],
+             sizeof(struct trace_event));
+    }
+
+    usb_stream_write(USB_STREAM_TRACE, record,
+                     (uint16_t)(2 + count * sizeof(struct trace_event)));
+  }
+}
+
+void trace_task(void *pvParameters) {
+  (void)pvParameters;
+
+  TickType_t xLastWakeTime = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(TRACE_DUMP_PERIOD_MS));
+
+    if (!stdio_usb_connected()) {
+      continue;
+    }
+
+    // Freeze both rings so the dump is one consistent window, then start over
+    frozen = true;
+    trace_dump_tasks();
+    for (uint core = 0; core < TRACE_CORES; core++) {
+      trace_dump_ring(core);
+      rings[core].head = 0;
+    }
+    frozen = false;
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <pico.h>
+
+// Per-core ring of fixed size events. Each core only ever writes its own
+// ring, and an event is claimed and filled with interrupts masked, so tasks,
+// ISRs and the render loop can all record without locks. trace_task() dumps
+// both rings over USB (USB_STREAM_TRACE), tools/trace2json.py turns the dump
+// into Chrome trace_event JSON for Perfetto.
+
+#define TRACE_RING_EVENTS 1024 // Per core, must be a power of two
+#define TRACE_DUMP_PERIOD_MS 5000
+
+enum trace_event_type {
+  TRACE_TASK_IN = 1,        // arg16: FreeRTOS task number
+  TRACE_TASK_OUT = 2,       // arg16: FreeRTOS task number
+  TRACE_ISR_ENTER = 3,      // arg8: enum stats_isr
+  TRACE_ISR_EXIT = 4,       // arg8: enum stats_isr
+  TRACE_MUTEX_WAIT = 5,     // arg8: enum trace_mutex, blocked on a lock
+  TRACE_MUTEX_TAKEN = 6,    // arg8: enum trace_mutex, got it after waiting
+  TRACE_SCANLINE_BEGIN = 7, // arg16: scanline number
+  TRACE_SCANLINE_END = 8,   // arg16: scanline number
+};
+
+enum trace_mutex {
+  TRACE_MUTEX_RENDER,
+  TRACE_MUTEX_GAME,
+};
+
+struct trace_event {
+  uint32_t timestamp; // Microseconds, shared timer so both cores agree
+  uint8_t type;
+  uint8_t arg8;
+  uint16_t arg16;
+};
+
+// -------- Dump format --------
+//
+// USB_STREAM_TRACE payloads start with a record kind:
+//   TRACE_RECORD_TASK:   kind | task number (LE16) | name
+//   TRACE_RECORD_EVENTS: kind | core | struct trace_event ...
+
+#define TRACE_RECORD_TASK 0
+#define TRACE_RECORD_EVENTS 1
+
+// -------- Dump format --------
+
+void trace_record(uint8_t type, uint8_t arg8, uint16_t arg16);
+
+// Called from the FreeRTOS trace hooks in FreeRTOSConfig.h
+void trace_task_switched_in(unsigned int task_number);
+void trace_task_switched_out(unsigned int task_number);
+
+// Low priority FreeRTOS task that dumps the rings every TRACE_DUMP_PERIOD_MS
+void trace_task(void *pvParameters);
+
+#endif
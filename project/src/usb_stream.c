@@ -0,0 +1,29 @@
+#include <pico/stdio/driver.h>
+#include <pico/stdio_usb.h>
+#include <string.h>
+
+#include "usb_stream.h"
+
+bool usb_stream_write(uint8_t channel, const void *data, uint16_t len) {
+  uint8_t frame[USB_STREAM_MAX_PAYLOAD + 5];
+
+  if (len > USB_STREAM_MAX_PAYLOAD || !stdio_usb_connected()) {
+    return false;
+  }
+
+  frame[0] = USB_STREAM_SYNC;
+  frame[1] = channel;
+  frame[2] = (uint8_t)len;
+  frame[3] = (uint8_t)(len >> 8);
+  memcpy(&frame[4], data, len);
+
+  uint8_t checksum = 0;
+  for (uint i = 1; i < 4u + len; i++) {
+    checksum ^= frame[i];
+  }
+  frame[4 + len] = checksum;
+
+  // Straight to the USB driver: no CR/LF translation and a single write
+  stdio_usb.out_chars((const char *)frame, (int)(len + 5));
+  return true;
+}
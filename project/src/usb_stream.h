@@ -0,0 +1,28 @@
+#ifndef _USB_STREAM_H_
+#define _USB_STREAM_H_
+
+#include <pico.h>
+
+// Binary frames multiplexed with the regular printf text on USB stdio:
+//
+// USB_STREAM_SYNC | channel | length (LE16) | payload | checksum
+//
+// The checksum is the XOR of channel, length and payload bytes. Frames go out
+// in one driver call, bypassing CR/LF translation, so text never lands in the
+// middle of one. tools/usb_stream.py splits the channels back apart.
+
+#define USB_STREAM_SYNC 0xA5
+#define USB_STREAM_MAX_PAYLOAD 256
+
+enum usb_stream_channel {
+  USB_STREAM_REPLAY = 1,  // Input recording, see replay.h
+  USB_STREAM_TRACE = 2,   // Trace ring dump, see trace.h
+  USB_STREAM_CAPTURE = 3, // Screen capture, see capture.h
+  USB_STREAM_LOG = 4,     // Deferred log records, see log.h
+  USB_STREAM_CONTROL = 5, // Replies to control packets, see control.h
+};
+
+// Returns false if no host is connected
+bool usb_stream_write(uint8_t channel, const void *data, uint16_t len);
+
+#endif
@@ -1,14 +1,23 @@
+#include <hardware/interp.h>
+#include <hardware/sync.h>
 #include <pico/scanvideo.h>
 #include <pico/scanvideo/composable_scanline.h>
 #include <pico/scanvideo/scanvideo_base.h>
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "kernels.h"
 #include "vga.h"
 
 extern const struct scanvideo_pio_program video_24mhz_composable;
 
+static_assert(PICO_SCANVIDEO_PIXEL_FROM_RGB5(1, 2, 4) ==
+                  (1 << BLEND_R_SHIFT | 2 << BLEND_G_SHIFT |
+                   4 << BLEND_B_SHIFT),
+              "blend.h assumes a different pixel layout");
+
 static inline uint16_t *
 prepare_scanline_buffer(struct scanvideo_scanline_buffer *dest, uint width);
 
@@ -16,109 +25,498 @@ static inline void
 finalize_scanline_buffer(struct scanvideo_scanline_buffer *dest);
 
 void vga_init() {
+  assert(CANVAS_WIDTH == CANVAS_COLUMNS && CANVAS_HEIGHT == CANVAS_ROWS);
   scanvideo_setup(&VGA_MODE);
   scanvideo_timing_enable(true);
 
   (void)vga_get_canvas(); // force canvas initialization :^)
 }
 
-uint16_t *vga_get_canvas() {
-  static uint16_t canvas[320 * 240] = {0};
+uint16_t *__not_in_flash_func(vga_get_canvas)() {
+#if VGA_BANKED_CANVAS
+  // Rows 0-101 in SRAM1, 102-204 in SRAM2 and the rest in SRAM3
+  static uint16_t canvas[CANVAS_COLUMNS * CANVAS_ROWS]
+      __attribute__((section(".canvas")));
+#else
+  static uint16_t canvas[CANVAS_COLUMNS * CANVAS_ROWS] = {0};
+#endif
   return canvas;
 }
 
-uint16_t *vga_get_next_canvas_slice(uint16_t *canvas) {
-  static size_t current_row_index = 0;
+// -------- Row table --------
+
+// Shown by every cleared row until something is drawn into it. Never written.
+static uint16_t blank_line[CANVAS_COLUMNS];
+
+// Per canvas row: its storage, or blank_line while it is cleared
+static uint16_t *rows[CANVAS_ROWS];
+
+// Per screen line: the row scanout copies, rebuilt on every view change
+static const uint16_t *lines[CANVAS_ROWS];
+
+static struct vga_view view;
+
+// Bumped by every write into a row. Each scanline buffer remembers which row
+// and version it holds, one dirty bit per row could not tell them apart.
+static uint16_t row_version[CANVAS_ROWS];
+
+// Serialises the first write into a cleared row, jobs on both cores may
+// reach the same row at once
+static spin_lock_t *rows_lock;
+
+static bool __not_in_flash_func(vga_view_is_split)(uint line) {
+  return view.split != 0 && line >= view.split;
+}
+
+// Canvas row shown on a screen line under the current view
+static uint __not_in_flash_func(vga_view_row)(uint line) {
+  int offset = vga_view_is_split(line) ? view.split_scroll : view.scroll;
+  int row = ((int)line + offset + view.shake) % (int)CANVAS_HEIGHT;
+  return (uint)(row < 0 ? row + (int)CANVAS_HEIGHT : row);
+}
+
+static void vga_rebuild_lines(void) {
+  for (uint line = 0; line < CANVAS_HEIGHT; line++) {
+    lines[line] = rows[vga_view_row(line)];
+  }
+}
+
+// Screen line showing `row` above the split (split = 0) or below it, or -1
+static int __not_in_flash_func(vga_row_line)(uint row, uint split) {
+  int offset = (split ? view.split_scroll : view.scroll) + view.shake;
+  int line = ((int)row - offset) % (int)CANVAS_HEIGHT;
+  if (line < 0) {
+    line += CANVAS_HEIGHT;
+  }
+  return vga_view_is_split((uint)line) == (bool)split ? line : -1;
+}
+
+// Points the screen lines that show `row` at its storage again
+static void __not_in_flash_func(vga_show_row)(uint row) {
+  for (uint split = 0; split < 2; split++) {
+    int line = vga_row_line(row, split);
+    if (line >= 0) {
+      lines[line] = rows[row];
+    }
+  }
+}
+
+uint16_t *__not_in_flash_func(vga_canvas_row)(uint16_t *canvas, size_t y) {
+  row_version[y]++; // A lost race between cores still changes the value
+
+  uint16_t *row = rows[y];
+  if (row != blank_line && row != NULL) {
+    return row;
+  }
 
-  // Update logic: Cycle through rows
-  current_row_index++;
-  if (current_row_index >= CANVAS_HEIGHT) {
-    current_row_index = 0;
+  uint32_t irq = spin_lock_blocking(rows_lock);
+  row = rows[y];
+  if (row == blank_line || row == NULL) {
+    // A cleared row really becomes black only once it is drawn into
+    row = &canvas[y * CANVAS_WIDTH];
+    memset(row, 0, CANVAS_WIDTH * sizeof(uint16_t));
+    rows[y] = row;
+    vga_show_row(y);
   }
+  spin_unlock(rows_lock, irq);
+  return row;
+}
 
-  return &canvas[current_row_index * CANVAS_WIDTH];
+const uint16_t *__not_in_flash_func(vga_get_scanout_line)(uint line) {
+  const uint16_t *row = lines[line];
+  return row ? row : blank_line;
+}
+
+uint16_t vga_get_scanout_version(uint line) {
+  return row_version[vga_view_row(line)];
 }
 
 void vga_clear_canvas(uint16_t *canvas) {
-  memset(canvas, 0, CANVAS_WIDTH * CANVAS_HEIGHT * sizeof(uint16_t));
+  (void)canvas;
+
+  if (!rows_lock) {
+    rows_lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+  }
+
+  // Pointer rewrites only, the pixels are dropped when a row is next drawn
+  for (uint y = 0; y < CANVAS_HEIGHT; y++) {
+    rows[y] = blank_line;
+  }
+  vga_rebuild_lines();
+}
+
+int vga_get_row_line(uint row) {
+  int line = vga_row_line(row, 0);
+  return line >= 0 ? line : vga_row_line(row, 1);
+}
+
+void vga_set_view(const struct vga_view *new_view) {
+  view = *new_view;
+  if (view.split > CANVAS_HEIGHT) {
+    view.split = CANVAS_HEIGHT;
+  }
+  vga_rebuild_lines();
+}
+
+// -------- Row table --------
+
+// -------- Background --------
+
+#define VGA_FOCAL 160 // Screen pixels to the floor's image plane, 90 degrees
+
+// sin() of the first quarter turn in 1/64 steps, Q14
+static const int16_t quarter_sine[65] = {
+    0,     402,   804,   1205,  1606,  2006,  2404,  2801,  3196,  3590,
+    3981,  4370,  4756,  5139,  5520,  5897,  6270,  6639,  7005,  7366,
+    7723,  8076,  8423,  8765,  9102,  9434,  9760,  10080, 10394, 10702,
+    11003, 11297, 11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+    13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978, 15137, 15286,
+    15426, 15557, 15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261,
+    16305, 16340, 16364, 16379, 16384,
+};
+
+// The layer as scanout uses it. Written and read with the canvas lock held.
+static struct vga_layer {
+  struct vga_background set; // As last set, to tell whether it moved
+  int32_t cos;               // Of the angle, Q14
+  int32_t sin;
+  interp_config lanes[2];    // Turn u and v into a texel offset
+} layer;
+
+// Texture walk along one screen line, 16.16
+struct vga_walk {
+  uint32_t u;
+  uint32_t v;
+  uint32_t du;
+  uint32_t dv;
+};
+
+static int32_t vga_sin(uint16_t angle) {
+  uint step = angle >> 8; // 256 steps per turn
+  uint index = step & 63;
+  int32_t value = quarter_sine[step & 64 ? 64 - index : index];
+  return step & 128 ? -value : value;
+}
+
+static bool vga_background_equal(const struct vga_background *a,
+                                 const struct vga_background *b) {
+  return a->texture == b->texture && a->mode == b->mode &&
+         a->horizon == b->horizon && a->u == b->u && a->v == b->v &&
+         a->angle == b->angle && a->scale == b->scale;
+}
+
+void vga_set_background(const struct vga_background *background) {
+  struct vga_background next = *background;
+  if (!next.texture) {
+    next.mode = VGA_BACKGROUND_OFF;
+  }
+  if (vga_background_equal(&layer.set, &next)) {
+    return; // The walk set up for it still holds
+  }
+
+  layer.set = next;
+  if (layer.set.mode == VGA_BACKGROUND_OFF) {
+    return;
+  }
+
+  layer.cos = vga_sin((uint16_t)(next.angle + 0x4000));
+  layer.sin = vga_sin(next.angle);
+
+  // Lane 0 makes the column and lane 1 the row of the texel from the
+  // integer parts of u and v, pop[2] adds both to the texture address and
+  // steps the two accumulators by du and dv
+  uint width_bits = layer.set.texture->width_bits;
+  uint height_bits = layer.set.texture->height_bits;
+  interp_config lane = interp_default_config();
+  interp_config_set_add_raw(&lane, true);
+  interp_config_set_shift(&lane, 16 - 1);
+  interp_config_set_mask(&lane, 1, width_bits);
+  layer.lanes[0] = lane;
+  interp_config_set_shift(&lane, 16 - 1 - width_bits);
+  interp_config_set_mask(&lane, width_bits + 1, width_bits + height_bits);
+  layer.lanes[1] = lane;
+}
+
+// Whether the layer shows on a screen line at all
+static bool __not_in_flash_func(vga_background_covers)(uint line) {
+  return layer.set.mode == VGA_BACKGROUND_AFFINE ||
+         (layer.set.mode == VGA_BACKGROUND_FLOOR && line > layer.set.horizon);
 }
 
-void vga_render_scanline(struct scanvideo_scanline_buffer *dest,
-                         uint16_t *canvas_slice) {
+// Where `line` starts in the texture and how far each pixel steps, false if
+// the layer does not reach the line
+static bool __not_in_flash_func(vga_background_walk)(uint line,
+                                                     struct vga_walk *walk) {
+  int64_t k; // Texels per pixel along the line, 16.16
+  int64_t origin_u = (int64_t)layer.set.u << 8;
+  int64_t origin_v = (int64_t)layer.set.v << 8;
+
+  switch (layer.set.mode) {
+  case VGA_BACKGROUND_AFFINE: {
+    k = (int64_t)layer.set.scale << 8;
+    int64_t dy = (int64_t)line - CANVAS_HEIGHT / 2;
+    int64_t half = CANVAS_WIDTH / 2;
+    origin_u += k * (layer.sin * dy - layer.cos * half) >> 14;
+    origin_v += k * (layer.cos * dy + layer.sin * half) >> 14;
+    walk->dv = (uint32_t)(-k * layer.sin >> 14);
+    break;
+  }
+  case VGA_BACKGROUND_FLOOR: {
+    if (line <= layer.set.horizon) {
+      return false;
+    }
+    // The floor one line below the horizon is `scale` texels per pixel
+    // away, and the distance falls off with the lines below that
+    k = ((uint32_t)layer.set.scale << 8) / (line - layer.set.horizon);
+    // Centre of the line straight ahead, then half a screen to the left
+    int64_t half = CANVAS_WIDTH / 2;
+    origin_u += k * (layer.sin * VGA_FOCAL - layer.cos * half) >> 14;
+    origin_v -= k * (layer.cos * VGA_FOCAL + layer.sin * half) >> 14;
+    walk->dv = (uint32_t)(k * layer.sin >> 14);
+    break;
+  }
+  default:
+    return false;
+  }
+
+  walk->u = (uint32_t)origin_u;
+  walk->v = (uint32_t)origin_v;
+  walk->du = (uint32_t)(k * layer.cos >> 14);
+  return true;
+}
+
+// The row over the layer, black pixels let the texture through. Only the
+// render task uses interp0 on core 1, it is set up again for every line
+// all the same, that is a handful of stores against 320 pops.
+static void __not_in_flash_func(vga_compose_scanline)(
+    struct scanvideo_scanline_buffer *dest, const uint16_t *source,
+    const struct vga_walk *walk) {
   uint16_t *color_buffer = prepare_scanline_buffer(dest, CANVAS_WIDTH);
 
-  // Copy the row from the canvas to the color buffer
-  for (size_t px = 0; px < CANVAS_WIDTH; px++) {
-    color_buffer[px] = canvas_slice[px];
+  interp_set_config(interp0, 0, &layer.lanes[0]);
+  interp_set_config(interp0, 1, &layer.lanes[1]);
+  interp0->base[2] = (uintptr_t)layer.set.texture->texels;
+  interp0->accum[0] = walk->u;
+  interp0->base[0] = walk->du;
+  interp0->accum[1] = walk->v;
+  interp0->base[1] = walk->dv;
+
+  if (source == blank_line) {
+    for (size_t px = 0; px < CANVAS_WIDTH; px++) {
+      color_buffer[px] = *(const uint16_t *)interp0->pop[2];
+    }
+  } else {
+    for (size_t px = 0; px < CANVAS_WIDTH; px++) {
+      uint16_t texel = *(const uint16_t *)interp0->pop[2];
+      color_buffer[px] = source[px] ? source[px] : texel;
+    }
   }
 
   finalize_scanline_buffer(dest);
 }
 
-void vga_draw_rectangle_filled(uint16_t *canvas, const pong_rect *rect) {
-  // Erase old rectangle by setting its pixels to 0
-  for (size_t row = 0; row < rect->h; row++) {
-    size_t canvas_y = rect->y_old + row;
-    if (canvas_y >= CANVAS_HEIGHT)
-      break;
+// -------- Background --------
+
+// -------- Scanout cache --------
+
+#define VGA_ROW_TOKENS 32 // Encoding kept per row, busier rows are copied
+
+// The run-length encoding of every canvas row as of `version`. A row that
+// has not changed since its last scanline is a copy of a few words from
+// here, only rows drawn into since cost a pass over their pixels.
+static struct vga_row_cache {
+  uint32_t data[VGA_ROW_TOKENS / 2];
+  uint16_t version;
+  uint8_t data_used; // 0 when the row did not fit and is copied as is
+  bool valid;
+} row_cache[CANVAS_ROWS];
+
+static struct vga_scanout_counts counts;
+
+// A black line is a single run, whatever the width
+static void __not_in_flash_func(encode_blank_scanline)(
+    struct scanvideo_scanline_buffer *dest, uint width) {
+  uint16_t *tokens = (uint16_t *)dest->data;
+  tokens[0] = COMPOSABLE_COLOR_RUN;
+  tokens[1] = 0;
+  tokens[2] = (uint16_t)(width - 3);
+  tokens[3] = COMPOSABLE_RAW_1P; // Lines end on a black pixel
+  tokens[4] = 0;
+  tokens[5] = COMPOSABLE_EOL_ALIGN;
+  dest->data_used = 3;
+  dest->status = SCANLINE_OK;
+}
+
+// Whether a colour run starts at `px`, shorter ones cost more than raw pixels
+static bool __not_in_flash_func(vga_run_at)(const uint16_t *source, uint px,
+                                            uint width) {
+  return px + 2 < width && source[px] == source[px + 1] &&
+         source[px] == source[px + 2];
+}
 
-    for (size_t col = 0; col < rect->w; col++) {
-      size_t canvas_x = rect->x_old + col;
-      if (canvas_x >= CANVAS_WIDTH)
-        break;
+// Encodes a row as colour runs and raw pixels, ending on a black pixel.
+// Returns the words used, or 0 if it takes more than `max_tokens`.
+static uint __not_in_flash_func(vga_encode_row)(uint32_t *data,
+                                                uint max_tokens,
+                                                const uint16_t *source,
+                                                uint width) {
+  uint16_t *tokens = (uint16_t *)data;
+  uint n = 0;
+  uint px = 0;
 
-      // Clear pixel if it is outside the new rectangle
-      if (canvas_x < rect->x || canvas_x >= rect->x + rect->w ||
-          canvas_y < rect->y || canvas_y >= rect->y + rect->h) {
-        size_t index = canvas_y * CANVAS_WIDTH + canvas_x;
-        canvas[index] = 0; // Clear pixel
+  // Four tokens stay free for the black pixel and the end of line
+  while (px < width) {
+    if (vga_run_at(source, px, width)) {
+      uint end = px + 3;
+      while (end < width && source[end] == source[px]) {
+        end++;
+      }
+      if (n + 3 + 4 > max_tokens) {
+        return 0;
+      }
+      tokens[n++] = COMPOSABLE_COLOR_RUN;
+      tokens[n++] = source[px];
+      tokens[n++] = (uint16_t)(end - px - 3);
+      px = end;
+      continue;
+    }
+
+    uint end = px + 1;
+    while (end < width && !vga_run_at(source, end, width)) {
+      end++;
+    }
+    uint len = end - px;
+    if (n + len + 2 + 4 > max_tokens) {
+      return 0;
+    }
+    if (len == 1) {
+      tokens[n++] = COMPOSABLE_RAW_1P;
+      tokens[n++] = source[px];
+    } else if (len == 2) {
+      tokens[n++] = COMPOSABLE_RAW_2P;
+      tokens[n++] = source[px];
+      tokens[n++] = source[px + 1];
+    } else {
+      tokens[n++] = COMPOSABLE_RAW_RUN;
+      tokens[n++] = source[px];
+      tokens[n++] = (uint16_t)(len - 3);
+      for (uint i = 1; i < len; i++) {
+        tokens[n++] = source[px + i];
       }
     }
+    px = end;
   }
 
-  // Draw new rectangle
-  for (size_t row = 0; row < rect->h; row++) {
-    size_t canvas_y = rect->y + row;
-    if (canvas_y >= CANVAS_HEIGHT)
-      break;
+  tokens[n++] = COMPOSABLE_RAW_1P;
+  tokens[n++] = 0;
+  if (n & 1) {
+    tokens[n++] = COMPOSABLE_EOL_ALIGN;
+  } else {
+    tokens[n++] = COMPOSABLE_EOL_SKIP_ALIGN;
+    tokens[n++] = 0;
+  }
+  return n / 2;
+}
 
-    for (size_t col = 0; col < rect->w; col++) {
-      size_t canvas_x = rect->x + col;
-      if (canvas_x >= CANVAS_WIDTH)
-        break;
+void __not_in_flash_func(vga_render_scanline)(
+    struct scanvideo_scanline_buffer *dest, uint line) {
+  const uint16_t *source = vga_get_scanout_line(line);
+  uint row = vga_view_row(line);
 
-      size_t index = canvas_y * CANVAS_WIDTH + canvas_x;
-      canvas[index] = rect->color; // Set pixel to the rectangle's color
-    }
+  struct vga_walk walk;
+  if (vga_background_covers(line) && vga_background_walk(line, &walk)) {
+    // The layer differs from line to line, so these are composed every time
+    vga_compose_scanline(dest, source, &walk);
+    counts.layered++;
+    return;
   }
-}
-// Draw a rectangle with borders only
-void vga_draw_rectangle_border(uint16_t *canvas, size_t x, size_t y,
-                               size_t width, size_t height, uint16_t color) {
-  // Top and bottom borders
-  for (size_t col = 0; col < width; col++) {
-    size_t top_index = y * CANVAS_WIDTH + (x + col);
-    size_t bottom_index = (y + height - 1) * CANVAS_WIDTH + (x + col);
 
-    if (x + col < CANVAS_WIDTH) {
-      if (y < CANVAS_HEIGHT)
-        canvas[top_index] = color; // Top border
-      if (y + height - 1 < CANVAS_HEIGHT)
-        canvas[bottom_index] = color; // Bottom border
+  if (source == blank_line) {
+    encode_blank_scanline(dest, CANVAS_WIDTH);
+    counts.blank++;
+    return;
+  }
+
+  // Read before the pixels: a write racing the encoding bumps it again, and
+  // the next frame encodes the row once more
+  uint16_t version = row_version[row];
+  struct vga_row_cache *cache = &row_cache[row];
+  if (!cache->valid || cache->version != version) {
+    cache->version = version;
+    cache->data_used =
+        (uint8_t)vga_encode_row(cache->data, VGA_ROW_TOKENS, source,
+                                CANVAS_WIDTH);
+    cache->valid = true;
+    if (cache->data_used) {
+      counts.encoded++;
     }
+  } else if (cache->data_used) {
+    counts.reused++;
+  }
+
+  if (cache->data_used) {
+    memcpy(dest->data, cache->data, cache->data_used * sizeof(uint32_t));
+    dest->data_used = cache->data_used;
+    dest->status = SCANLINE_OK;
+    return;
+  }
+
+  uint16_t *color_buffer = prepare_scanline_buffer(dest, CANVAS_WIDTH);
+
+  // Copy the row from the canvas to the color buffer
+  for (size_t px = 0; px < CANVAS_WIDTH; px++) {
+    color_buffer[px] = source[px];
   }
 
-  // Left and right borders
+  finalize_scanline_buffer(dest);
+  counts.copied++;
+}
+
+void vga_get_scanout_counts(struct vga_scanout_counts *out) { *out = counts; }
+
+// -------- Scanout cache --------
+
+// Both go through the C++ kernels, which have unrolled instances for the
+// widths the games draw every frame
+void __not_in_flash_func(vga_fill_rectangle)(uint16_t *canvas, size_t x,
+                                             size_t y, size_t width,
+                                             size_t height, uint16_t color) {
+  struct raster_target target = vga_raster_target(canvas);
+  kernel_fill_rect(&target, (int)x, (int)y, (int)width, (int)height, color);
+}
+
+void __not_in_flash_func(vga_move_rectangle)(uint16_t *canvas, size_t x_old,
+                                             size_t y_old, size_t x, size_t y,
+                                             size_t width, size_t height,
+                                             uint16_t color) {
+  struct raster_target target = vga_raster_target(canvas);
+  kernel_move_rect(&target, (int)x_old, (int)y_old, (int)x, (int)y,
+                   (int)width, (int)height, color);
+}
+
+struct raster_target __not_in_flash_func(vga_raster_target)(
+    uint16_t *canvas) {
+  return (struct raster_target){
+      .canvas = canvas,
+      .row = vga_canvas_row,
+      .width = CANVAS_WIDTH,
+      .height = CANVAS_HEIGHT,
+  };
+}
+
+void __not_in_flash_func(vga_fade_rectangle)(uint16_t *canvas, size_t x,
+                                             size_t y, size_t width,
+                                             size_t height, uint16_t color,
+                                             uint alpha) {
+  if (x >= CANVAS_WIDTH || y >= CANVAS_HEIGHT)
+    return;
+  if (x + width > CANVAS_WIDTH)
+    width = CANVAS_WIDTH - x;
+  if (y + height > CANVAS_HEIGHT)
+    height = CANVAS_HEIGHT - y;
+
   for (size_t row = 0; row < height; row++) {
-    size_t left_index = (y + row) * CANVAS_WIDTH + x;
-    size_t right_index = (y + row) * CANVAS_WIDTH + (x + width - 1);
-
-    if (y + row < CANVAS_HEIGHT) {
-      if (x < CANVAS_WIDTH)
-        canvas[left_index] = color; // Left border
-      if (x + width - 1 < CANVAS_WIDTH)
-        canvas[right_index] = color; // Right border
-    }
+    blend_fade_span(vga_canvas_row(canvas, y + row) + x, width, color, alpha);
   }
 }
 
@@ -5,25 +5,136 @@
 #include <pico/scanvideo/composable_scanline.h>
 #include <pico/scanvideo/scanvideo_base.h>
 
+#include "blend.h"
 #include "game.h"
+#include "raster.h"
 
 #define VGA_MODE vga_mode_320x240_60
 #define CANVAS_WIDTH VGA_MODE.width
 #define CANVAS_HEIGHT VGA_MODE.height
 #define CANVAS_SIZE (CANVAS_WIDTH * CANVAS_HEIGHT)
 
+// The same size as constants for array bounds, vga_init() checks they match
+#define CANVAS_COLUMNS 320
+#define CANVAS_ROWS 240
+
+// Set by the MAIN_BANKED_CANVAS build: the canvas lives in SRAM1-3 through
+// the non-striped aliases (see memmap_banked.ld) and is not zeroed at boot
+#ifndef VGA_BANKED_CANVAS
+#define VGA_BANKED_CANVAS 0
+#endif
+
 uint16_t *vga_get_canvas(void);
-uint16_t *vga_get_next_canvas_slice(uint16_t *canvas);
 
 void vga_init(void);
 
+// -------- Row table --------
+
+// Scanout goes through a pointer per canvas row and a pointer per screen
+// line, so clearing, scrolling, shaking and splitting the screen only
+// rewrite pointers. Canvas coordinates never move, the view does.
+struct vga_view {
+  uint16_t scroll;       // Screen line n shows canvas row n + scroll
+  uint16_t split;        // Screen lines from here on use split_scroll, 0 = off
+  uint16_t split_scroll; // Scroll for the lines below the split
+  int16_t shake;         // Added to both scrolls
+};
+
+// Writable row y of the canvas. Every canvas write goes through here, a
+// row left blank by vga_clear_canvas() is zeroed on its first write.
+uint16_t *vga_canvas_row(uint16_t *canvas, size_t y);
+
+// What scanout should copy for a screen line
+const uint16_t *vga_get_scanout_line(uint line);
+
+// Changes whenever the row shown on a screen line is written to. Pairs with
+// the pointer above to tell whether a line still shows the same pixels.
+uint16_t vga_get_scanout_version(uint line);
+
+// Points every row at a shared black line, nothing is written. Also sets the
+// table up, so it runs once before anything is drawn.
 void vga_clear_canvas(uint16_t *canvas);
 
-void vga_render_scanline(struct scanvideo_scanline_buffer *dest,
-                         uint16_t *canvas_slice);
+void vga_set_view(const struct vga_view *view);
+
+// Screen line that shows canvas row `row` under the current view, or -1
+int vga_get_row_line(uint row);
+
+// -------- Row table --------
+
+// -------- Scanout cache --------
+
+// Fills a scanline buffer with a screen line. Every canvas row keeps its
+// run-length encoding until it is drawn into, so a row unchanged since its
+// last scanline is a copy of a few words and a blank row a single black run.
+// Only rows that changed, or are too busy to keep, cost a pass over their
+// pixels. Lines the background layer covers are composed with it every time.
+void vga_render_scanline(struct scanvideo_scanline_buffer *dest, uint line);
+
+struct vga_scanout_counts {
+  uint32_t copied;  // Full 320 pixel copies, the row was too busy to keep
+  uint32_t encoded; // Row changed and was encoded again
+  uint32_t reused;  // Encoding of the unchanged row copied
+  uint32_t blank;   // Encoded as one black run
+  uint32_t layered; // Composed over the background layer
+};
+
+// Running totals since boot
+void vga_get_scanout_counts(struct vga_scanout_counts *counts);
+
+// -------- Scanout cache --------
+
+// -------- Background --------
+
+// A texture drawn behind the canvas by scanout itself, rotated and scaled
+// ("affine") or laid out as a floor in perspective below a horizon. Black
+// canvas pixels and blank rows show it. Core 1 walks the texture with its
+// interpolator while it fills each scanline buffer, so moving the layer
+// costs core 0 one command per frame and no pixels.
+
+enum vga_background_mode {
+  VGA_BACKGROUND_OFF,
+  VGA_BACKGROUND_AFFINE, // Rotated and scaled about the screen centre
+  VGA_BACKGROUND_FLOOR,  // Ground plane in perspective below the horizon
+};
+
+// Texels in the canvas format, row after row. Scanout reads one per pixel,
+// so keep it in RAM rather than in flash. Both sides are powers of two from
+// 2 to 256, the texture repeats in both directions.
+struct vga_texture {
+  const uint16_t *texels;
+  uint8_t width_bits; // 1 << width_bits texels wide
+  uint8_t height_bits;
+};
+
+struct vga_background {
+  const struct vga_texture *texture;
+  uint8_t mode;     // enum vga_background_mode
+  uint16_t horizon; // Floor: last screen line above the floor
+  uint16_t u;       // Texture position in 8.8: the screen centre when
+  uint16_t v;       // affine, the eye when a floor
+  uint16_t angle;   // Rotation, 65536 is a full turn
+  uint16_t scale;   // Texels per screen pixel in 8.8, on the floor the value
+                    // one line below the horizon
+};
+
+// Takes effect from the next scanline. Like the view, set it with the
+// canvas lock held.
+void vga_set_background(const struct vga_background *background);
+
+// -------- Background --------
+
+// Spans from the rasterizer land in the canvas through vga_canvas_row()
+struct raster_target vga_raster_target(uint16_t *canvas);
+
+void vga_fill_rectangle(uint16_t *canvas, size_t x, size_t y, size_t width,
+                        size_t height, uint16_t color);
 
-void vga_draw_rectangle_filled(uint16_t *canvas, const pong_rect *rect);
+void vga_move_rectangle(uint16_t *canvas, size_t x_old, size_t y_old,
+                        size_t x, size_t y, size_t width, size_t height,
+                        uint16_t color);
 
-void vga_draw_rectangle_border(uint16_t *canvas, size_t x, size_t y,
-                               size_t width, size_t height, uint16_t color);
+// Moves the pixels alpha / BLEND_ALPHA_MAX of the way toward color, clipped
+void vga_fade_rectangle(uint16_t *canvas, size_t x, size_t y, size_t width,
+                        size_t height, uint16_t color, uint alpha);
 #endif // _VGA_H_
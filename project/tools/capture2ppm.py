@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Rebuilds screen captures from the device as PPM files or a video.
+
+The device streams changed lines every CAPTURE_PERIOD_MS when built with
+MAIN_CAPTURE, see src/capture.h. Lines are applied to a framebuffer that
+starts black, and every frame record writes the framebuffer out.
+
+    capture2ppm.py /dev/ttyACM0 -o frames/
+    capture2ppm.py captured.bin --video session.mp4 --fps 10
+"""
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+from usb_stream import frames, open_input
+
+CHANNEL_CAPTURE = 3
+
+RECORD_LINE = 0
+RECORD_FRAME = 1
+
+WIDTH = 320
+HEIGHT = 240
+
+# PICO_SCANVIDEO_PIXEL_FROM_RGB5 layout
+R_SHIFT = 0
+G_SHIFT = 6
+B_SHIFT = 11
+
+
+def expand5(value):
+    return (value << 3) | (value >> 2)
+
+
+# RGB555 pixel to its three 8-bit PPM bytes, for every possible pixel
+PALETTE = [
+    bytes(
+        (
+            expand5((p >> R_SHIFT) & 31),
+            expand5((p >> G_SHIFT) & 31),
+            expand5((p >> B_SHIFT) & 31),
+        )
+    )
+    for p in range(1 << 16)
+]
+
+
+class Framebuffer:
+    def __init__(self):
+        self.rows = [bytearray(WIDTH * 3) for _ in range(HEIGHT)]
+
+    def apply_line(self, payload):
+        line, x = struct.unpack_from("<HH", payload, 1)
+        if line >= HEIGHT:
+            return
+        row = self.rows[line]
+        for i in range(5, len(payload) - 2, 3):
+            count = payload[i] + 1
+            (pixel,) = struct.unpack_from("<H", payload, i + 1)
+            end = min(x + count, WIDTH)
+            row[x * 3 : end * 3] = PALETTE[pixel] * (end - x)
+            x = end
+
+    def ppm(self):
+        return b"P6\n%d %d\n255\n" % (WIDTH, HEIGHT) + b"".join(self.rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="serial device or captured stream")
+    parser.add_argument("-o", "--out-dir", help="write frame-NNNNN.ppm here")
+    parser.add_argument("--video", help="encode to this file with ffmpeg")
+    parser.add_argument("--fps", type=float, default=10, help="video rate")
+    parser.add_argument("--frames", type=int, help="stop after this many")
+    args = parser.parse_args()
+
+    if not args.out_dir and not args.video:
+        parser.error("give --out-dir, --video or both")
+    if args.out_dir:
+        os.makedirs(args.out_dir, exist_ok=True)
+
+    encoder = None
+    if args.video:
+        encoder = subprocess.Popen(
+            ["ffmpeg", "-loglevel", "error", "-y", "-f", "image2pipe",
+             "-framerate", str(args.fps), "-c:v", "ppm", "-i", "-",
+             "-pix_fmt", "yuv420p", args.video],
+            stdin=subprocess.PIPE,
+        )
+
+    fb = Framebuffer()
+    written = 0
+    try:
+        with open_input(args.input) as f:
+            for channel, payload in frames(f):
+                if channel != CHANNEL_CAPTURE or not payload:
+                    continue
+                if payload[0] == RECORD_LINE:
+                    fb.apply_line(payload)
+                    continue
+                if payload[0] != RECORD_FRAME:
+                    continue
+
+                frame, sent, pending = struct.unpack_from("<HHH", payload, 1)
+                image = fb.ppm()
+                if args.out_dir:
+                    path = os.path.join(args.out_dir, "frame-%05d.ppm" % written)
+                    with open(path, "wb") as out:
+                        out.write(image)
+                if encoder:
+                    encoder.stdin.write(image)
+
+                written += 1
+                sys.stderr.write(
+                    "\rframe %u: %u lines, %u pending  " % (frame, sent, pending)
+                )
+                if args.frames and written >= args.frames:
+                    break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sys.stderr.write("\n%d frames\n" % written)
+        if encoder:
+            encoder.stdin.close()
+            encoder.wait()
+
+
+if __name__ == "__main__":
+    main()
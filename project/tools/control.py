@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Drives the device over the binary control protocol and times round trips.
+
+Packets are fixed 8-byte frames, see src/control.h. Replies come back as
+USB_STREAM_CONTROL frames among the regular printf text. Key names are read
+from src/infrared.h, so `input up` sends the same command as the remote.
+
+    control.py /dev/ttyACM0 ping --count 200
+    control.py /dev/ttyACM0 input up --count 50
+    control.py /dev/ttyACM0 set game 1
+    control.py /dev/ttyACM0 get ticks
+    control.py /dev/ttyACM0 compare
+
+`compare` sends inputs over USB, then prints the device's last input-to-photon
+time for both the USB and the IR path (press a remote key first for the
+latter). Exits non-zero if a reply is missing or reports an error.
+"""
+
+import argparse
+import os
+import queue
+import re
+import statistics
+import struct
+import sys
+import termios
+import threading
+import time
+import tty
+
+from usb_stream import frames
+
+CHANNEL_CONTROL = 5
+
+SYNC = 0x5A
+
+PING = 1
+INPUT = 2
+SET = 3
+GET = 4
+
+PARAMS = {"game": 0, "tick_ms": 1}
+STATES = {"ticks": 0, "game": 1, "latency_ir": 2, "latency_usb": 3}
+STATUS = ["ok", "bad type", "bad arg", "busy", "timeout"]
+
+REPLY = struct.Struct("<BBBBiI")
+
+INFRARED_H = os.path.join(os.path.dirname(__file__), "..", "src", "infrared.h")
+
+
+def load_keys(path):
+    """IR command codes by lower case name, IR_C_UP becomes "up"."""
+    with open(path) as f:
+        return {
+            name.lower(): int(code)
+            for name, code in re.findall(r"#define IR_C_(\w+) (\d+)", f.read())
+        }
+
+
+def packet(kind, seq, arg=0, value=0):
+    body = struct.pack("<BBBhB", kind, seq, arg, value, 0)
+    checksum = 0
+    for b in body:
+        checksum ^= b
+    return bytes([SYNC]) + body + bytes([checksum])
+
+
+class Link:
+    """Writes packets and matches replies to them by sequence number."""
+
+    def __init__(self, path, timeout):
+        # Read and write, unlike usb_stream.open_input()
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            tty.setraw(self.fd, termios.TCSANOW)
+        self.f = os.fdopen(self.fd, "rb", buffering=0)
+        self.timeout = timeout
+        self.seq = 0
+        self.replies = queue.Queue()
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        try:
+            for channel, payload in frames(self.f):
+                if channel == CHANNEL_CONTROL and len(payload) == REPLY.size:
+                    self.replies.put((time.perf_counter(),
+                                      REPLY.unpack(payload)))
+        except OSError:
+            pass  # The loopback peer went away
+
+    def request(self, kind, arg=0, value=0):
+        """Returns (round trip s, status, value), or None on a timeout."""
+        self.seq = (self.seq + 1) & 0xFF
+        sent = time.perf_counter()
+        os.write(self.fd, packet(kind, self.seq, arg, value))
+
+        deadline = sent + self.timeout
+        while True:
+            try:
+                received, reply = self.replies.get(
+                    timeout=max(0, deadline - time.perf_counter())
+                )
+            except queue.Empty:
+                return None
+            _, seq, status, _, value, _ = reply
+            if seq == self.seq:
+                return received - sent, status, value
+
+
+def report(name, times_us):
+    times_us = sorted(times_us)
+    p99 = times_us[min(len(times_us) - 1, len(times_us) * 99 // 100)]
+    print("%s: %d round trips, min %.0f us, median %.0f us, p99 %.0f us"
+          % (name, len(times_us), times_us[0], statistics.median(times_us),
+             p99))
+
+
+def run_timed(link, name, kind, arg, count, pause):
+    rtt, device = [], []
+    for _ in range(count):
+        result = link.request(kind, arg)
+        if result is None:
+            sys.exit("%s: no reply" % name)
+        seconds, status, value = result
+        if status != 0:
+            sys.exit("%s: %s" % (name, STATUS[status]))
+        rtt.append(seconds * 1e6)
+        device.append(value)
+        time.sleep(pause)
+
+    report(name, rtt)
+    if kind == INPUT:
+        print("%s: waited %.0f us on average for a tick on the device"
+              % (name, statistics.mean(device)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial device or pty")
+    parser.add_argument("--timeout", type=float, default=1.0,
+                        help="seconds to wait for a reply")
+    timed = argparse.ArgumentParser(add_help=False)
+    timed.add_argument("--count", type=int, default=100)
+    timed.add_argument("--pause", type=float, default=0.05,
+                       help="seconds between timed requests")
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("ping", parents=[timed])
+    sub.add_parser("input", parents=[timed]).add_argument("key")
+    set_parser = sub.add_parser("set")
+    set_parser.add_argument("param", choices=PARAMS)
+    set_parser.add_argument("value", type=int)
+    sub.add_parser("get").add_argument("state", choices=STATES)
+    sub.add_parser("compare", parents=[timed])
+    args = parser.parse_args()
+
+    keys = load_keys(INFRARED_H)
+    del keys["ok"]  # Means "no command" on the device, inputs never carry it
+    link = Link(args.port, args.timeout)
+
+    if args.command == "ping":
+        run_timed(link, "ping", PING, 0, args.count, args.pause)
+    elif args.command == "input":
+        if args.key not in keys:
+            sys.exit("unknown key %r, one of %s" % (args.key, " ".join(keys)))
+        run_timed(link, "input", INPUT, keys[args.key], args.count, args.pause)
+    elif args.command in ("set", "get"):
+        if args.command == "set":
+            result = link.request(SET, PARAMS[args.param], args.value)
+        else:
+            result = link.request(GET, STATES[args.state])
+        if result is None:
+            sys.exit("no reply")
+        _, status, value = result
+        if status != 0:
+            sys.exit(STATUS[status])
+        if args.command == "get":
+            print(value)
+    else:
+        run_timed(link, "ping", PING, 0, args.count, args.pause)
+        run_timed(link, "input", INPUT, keys["up"], args.count, args.pause)
+        for state in ("latency_usb", "latency_ir"):
+            result = link.request(GET, STATES[state])
+            if result is None:
+                sys.exit("no reply")
+            value = result[2]
+            print("%s input to photon: %s" % (
+                state[len("latency_"):],
+                "%d us" % value if value else "not measured yet"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Formats the device's deferred log records, interleaved with printf text.
+
+Call sites on the device only store a format id and raw arguments, see
+src/log.h. The format strings are read from that same header, so the tool
+always matches the firmware built from this tree.
+
+    log2text.py /dev/ttyACM0
+    log2text.py captured.bin --log-only
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+from usb_stream import frames, open_input
+
+CHANNEL_LOG = 4
+
+RECORD = struct.Struct("<IHBxII")
+
+LOG_H = os.path.join(os.path.dirname(__file__), "..", "src", "log.h")
+
+
+def load_formats(path):
+    """Format strings in enum log_format order, from the X-macro table."""
+    with open(path) as f:
+        source = f.read()
+    table = source[source.index("#define LOG_FORMATS(X)") :]
+    table = table[: table.index("\n\n")]
+    return [
+        (name, fmt.encode().decode("unicode_escape"))
+        for name, fmt in re.findall(r'X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', table)
+    ]
+
+
+def format_record(formats, timestamp, format_id, core, args):
+    if format_id >= len(formats):
+        text = "unknown format %u (%u, %u)" % (format_id, args[0], args[1])
+    else:
+        name, fmt = formats[format_id]
+        conversions = len(re.findall(r"%[^%]", fmt.replace("%%", "")))
+        try:
+            text = fmt % args[:conversions]
+        except (TypeError, ValueError):
+            text = "%s %r" % (name, args)
+    return "[%10.6f core %u] %s\n" % (timestamp / 1e6, core, text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="serial device or captured stream")
+    parser.add_argument("--log-h", default=LOG_H, help="where the formats are")
+    parser.add_argument("--log-only", action="store_true",
+                        help="drop the printf text")
+    args = parser.parse_args()
+
+    formats = load_formats(args.log_h)
+
+    def on_text(text):
+        if not args.log_only:
+            sys.stdout.write(text.decode("ascii", "replace"))
+            sys.stdout.flush()
+
+    with open_input(args.input) as f:
+        for channel, payload in frames(f, on_text):
+            if channel != CHANNEL_LOG:
+                continue
+            for offset in range(0, len(payload) - RECORD.size + 1, RECORD.size):
+                timestamp, format_id, core, arg0, arg1 = RECORD.unpack_from(
+                    payload, offset
+                )
+                sys.stdout.write(
+                    format_record(formats, timestamp, format_id, core,
+                                  (arg0, arg1))
+                )
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""Converts PNGs into span-compressed, palette-indexed sprites for sprite.h.
+
+Every sprite becomes a palette of canvas pixels and a list of spans per row:
+
+    row:  <spans> then <spans> times (<skip> <length> <colour index>)
+
+<skip> counts transparent pixels since the end of the previous span, so
+transparent pixels cost nothing to store or to draw. Longer gaps and runs are
+split, a span may be empty. Colours are cut down to RGB555 and packed with
+the shifts read from src/blend.h, the layout the canvas uses. Pixels with
+alpha below half are transparent.
+
+    png2sprite.py -o build/assets assets/heart.png
+
+writes build/assets.c and build/assets.h with one `const struct sprite
+sprite_<file name>` each and prints the flash footprint of every sprite.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+BLEND_H = os.path.join(os.path.dirname(__file__), "..", "src", "blend.h")
+
+MAX_COLORS = 256
+MAX_SPAN = 255
+
+
+def load_shifts(path):
+    """Bit position of the red, green and blue channel in a canvas pixel."""
+    with open(path) as f:
+        shifts = dict(re.findall(r"#define BLEND_([RGB])_SHIFT (\d+)",
+                                 f.read()))
+    return int(shifts["R"]), int(shifts["G"]), int(shifts["B"])
+
+
+# -------- PNG --------
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def unfilter(data, width, height, bpp):
+    stride = width * bpp
+    rows = []
+    prev = bytearray(stride)
+    at = 0
+    for _ in range(height):
+        kind = data[at]
+        row = bytearray(data[at + 1:at + 1 + stride])
+        at += 1 + stride
+        for i in range(stride):
+            left = row[i - bpp] if i >= bpp else 0
+            up = prev[i]
+            if kind == 1:
+                row[i] = (row[i] + left) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + up) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + (left + up) // 2) & 0xFF
+            elif kind == 4:
+                up_left = prev[i - bpp] if i >= bpp else 0
+                row[i] = (row[i] + paeth(left, up, up_left)) & 0xFF
+            elif kind != 0:
+                raise ValueError("bad filter type %d" % kind)
+        rows.append(row)
+        prev = row
+    return rows
+
+
+def read_png(path):
+    """Rows of (r, g, b, a) tuples. 8 bits per channel, no interlacing."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG")
+
+    at = 8
+    idat = b""
+    palette = []
+    alpha = b""
+    while at < len(data):
+        length, kind = struct.unpack(">I4s", data[at:at + 8])
+        body = data[at + 8:at + 8 + length]
+        at += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(
+                ">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, length, 3)]
+        elif kind == b"tRNS":
+            alpha = body
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+
+    if depth != 8 or interlace:
+        raise ValueError("only 8-bit, non-interlaced images are supported")
+    bpp = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    rows = unfilter(zlib.decompress(idat), width, height, bpp)
+
+    pixels = []
+    for row in rows:
+        out = []
+        for x in range(width):
+            p = row[x * bpp:(x + 1) * bpp]
+            if color == 0:
+                out.append((p[0], p[0], p[0], 255))
+            elif color == 2:
+                out.append((p[0], p[1], p[2], 255))
+            elif color == 3:
+                a = alpha[p[0]] if p[0] < len(alpha) else 255
+                out.append(palette[p[0]] + (a,))
+            elif color == 4:
+                out.append((p[0], p[0], p[0], p[1]))
+            else:
+                out.append(tuple(p))
+        pixels.append(out)
+    return width, height, pixels
+
+
+# -------- PNG --------
+
+def encode(pixels, shifts):
+    """Palette of canvas pixels and the span bytes, rows top to bottom."""
+    r_shift, g_shift, b_shift = shifts
+    palette = []
+    index = {}
+    spans = bytearray()
+    span_count = 0
+
+    for y, row in enumerate(pixels):
+        runs = []  # (skip, length, colour index)
+        skip = 0
+        x = 0
+        while x < len(row):
+            r, g, b, a = row[x]
+            if a < 128:
+                skip += 1
+                x += 1
+                continue
+            pixel = (r >> 3) << r_shift | (g >> 3) << g_shift | \
+                (b >> 3) << b_shift
+            if pixel not in index:
+                if len(palette) == MAX_COLORS:
+                    raise ValueError("more than %d colours" % MAX_COLORS)
+                index[pixel] = len(palette)
+                palette.append(pixel)
+
+            length = 1
+            while x + length < len(row) and row[x + length][3] >= 128 and \
+                    (row[x + length][0] >> 3, row[x + length][1] >> 3,
+                     row[x + length][2] >> 3) == (r >> 3, g >> 3, b >> 3):
+                length += 1
+
+            while skip > MAX_SPAN:
+                runs.append((MAX_SPAN, 0, 0))
+                skip -= MAX_SPAN
+            while length > MAX_SPAN:
+                runs.append((skip, MAX_SPAN, index[pixel]))
+                skip, length, x = 0, length - MAX_SPAN, x + MAX_SPAN
+            runs.append((skip, length, index[pixel]))
+            skip = 0
+            x += length
+
+        if len(runs) > MAX_SPAN:
+            raise ValueError("row %d needs more than %d spans" % (y, MAX_SPAN))
+        spans.append(len(runs))
+        for run in runs:
+            spans.extend(run)
+        span_count += len(runs)
+
+    return palette, bytes(spans), span_count
+
+
+def c_array(kind, name, values, per_line):
+    lines = ["static const %s %s[%d] = {" % (kind, name, len(values))]
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join(
+            ("0x%04x" if kind == "uint16_t" else "%d") % v
+            for v in values[i:i + per_line]) + ",")
+    lines.append("};")
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-o", "--output", required=True,
+                        help="path of the .c/.h pair, without extension")
+    parser.add_argument("png", nargs="+")
+    args = parser.parse_args()
+
+    shifts = load_shifts(BLEND_H)
+    header = os.path.basename(args.output) + ".h"
+    source = ["// Generated by tools/png2sprite.py, do not edit",
+              '#include "%s"' % header, ""]
+    declarations = []
+    names = []
+    total = 0
+
+    for path in args.png:
+        name = re.sub(r"\W", "_", os.path.splitext(os.path.basename(path))[0])
+        try:
+            width, height, pixels = read_png(path)
+            palette, spans, span_count = encode(pixels, shifts)
+        except (ValueError, KeyError, zlib.error) as e:
+            sys.exit("%s: %s" % (path, e))
+
+        source += c_array("uint16_t", name + "_palette", palette, 8)
+        source += c_array("uint8_t", name + "_spans", spans, 12)
+        source += [
+            "const struct sprite sprite_%s = {" % name,
+            "    .width = %d," % width,
+            "    .height = %d," % height,
+            "    .colors = %d," % len(palette),
+            "    .palette = %s_palette," % name,
+            "    .spans = %s_spans," % name,
+            "};",
+            "",
+        ]
+        declarations.append("extern const struct sprite sprite_%s;" % name)
+        names.append(name)
+
+        size = 2 * len(palette) + len(spans)
+        raw = 2 * width * height
+        total += size
+        print("png2sprite: %s %dx%d, %d colours, %d spans, %d B in flash "
+              "(%d B as raw pixels, %d%%)"
+              % (name, width, height, len(palette), span_count, size, raw,
+                 100 * size // raw))
+
+    print("png2sprite: %d sprites, %d B in flash" % (len(args.png), total))
+
+    guard = "_%s_" % re.sub(r"\W", "_", header).upper()
+    with open(args.output + ".h", "w") as f:
+        f.write("\n".join(["// Generated by tools/png2sprite.py, do not edit",
+                           "#ifndef " + guard, "#define " + guard, "",
+                           '#include "sprite.h"', ""] + declarations +
+                          ["", "// Every sprite above, for X(sprite_<name>)",
+                           "#define ASSET_SPRITES(X) " +
+                           " ".join("X(sprite_%s)" % n for n in names),
+                           "", "#endif", ""]))
+    with open(args.output + ".c", "w") as f:
+        f.write("\n".join(source))
+
+
+if __name__ == "__main__":
+    main()
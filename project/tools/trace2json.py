@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Converts trace ring dumps from the device into Chrome trace_event JSON.
+
+The device sends one dump every TRACE_DUMP_PERIOD_MS over USB stdio, see
+src/trace.h. Open the output in https://ui.perfetto.dev or chrome://tracing.
+
+    trace2json.py /dev/ttyACM0 -o trace.json --dumps 1
+    trace2json.py captured.bin -o trace.json
+"""
+
+import argparse
+import json
+import struct
+
+from usb_stream import frames, open_input
+
+CHANNEL_TRACE = 2
+
+RECORD_TASK = 0
+RECORD_EVENTS = 1
+
+TASK_IN = 1
+TASK_OUT = 2
+ISR_ENTER = 3
+ISR_EXIT = 4
+MUTEX_WAIT = 5
+MUTEX_TAKEN = 6
+SCANLINE_BEGIN = 7
+SCANLINE_END = 8
+
+ISR_NAMES = {0: "gpio"}
+MUTEX_NAMES = {0: "render_sync_mutex", 1: "game_state_mutex"}
+
+EVENT = struct.Struct("<IBBH")
+
+
+class Converter:
+    def __init__(self):
+        self.tasks = {}
+        self.out = []
+        self.last_ts = {}
+        self.wrap = {}
+        self.dumps = 0
+        self.last_core = None
+
+    def timestamp(self, core, ts):
+        # The device clock is 32 bits of microseconds, unwrap it per core
+        if core in self.last_ts and ts < self.last_ts[core]:
+            self.wrap[core] = self.wrap.get(core, 0) + (1 << 32)
+        self.last_ts[core] = ts
+        return ts + self.wrap.get(core, 0)
+
+    def event(self, ph, name, core, ts, cat, args=None):
+        event = {"ph": ph, "name": name, "pid": 0, "tid": core, "ts": ts, "cat": cat}
+        if args:
+            event["args"] = args
+        self.out.append(event)
+
+    def feed(self, payload):
+        kind = payload[0]
+        if kind == RECORD_TASK:
+            (number,) = struct.unpack_from("<H", payload, 1)
+            self.tasks[number] = payload[3:].decode("ascii", "replace")
+            return
+
+        if kind != RECORD_EVENTS:
+            return
+
+        core = payload[1]
+        # Core 0 always comes first in a dump
+        if core == 0 and self.last_core not in (None, 0):
+            self.dumps += 1
+        self.last_core = core
+
+        for offset in range(2, len(payload) - EVENT.size + 1, EVENT.size):
+            raw_ts, kind, arg8, arg16 = EVENT.unpack_from(payload, offset)
+            ts = self.timestamp(core, raw_ts)
+
+            if kind in (TASK_IN, TASK_OUT):
+                name = self.tasks.get(arg16, "task %d" % arg16)
+                self.event("B" if kind == TASK_IN else "E", name, core, ts, "task")
+            elif kind in (ISR_ENTER, ISR_EXIT):
+                name = "ISR " + ISR_NAMES.get(arg8, str(arg8))
+                self.event("B" if kind == ISR_ENTER else "E", name, core, ts, "isr")
+            elif kind in (MUTEX_WAIT, MUTEX_TAKEN):
+                name = "wait " + MUTEX_NAMES.get(arg8, str(arg8))
+                self.event("B" if kind == MUTEX_WAIT else "E", name, core, ts, "mutex")
+            elif kind in (SCANLINE_BEGIN, SCANLINE_END):
+                ph = "B" if kind == SCANLINE_BEGIN else "E"
+                self.event(ph, "scanline", core, ts, "video", {"line": arg16})
+
+    def json(self):
+        meta = [
+            {"ph": "M", "name": "thread_name", "pid": 0, "tid": core,
+             "args": {"name": "core %d" % core}}
+            for core in sorted(self.last_ts)
+        ]
+        return {"traceEvents": meta + self.out}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="serial device or captured stream")
+    parser.add_argument("-o", "--output", default="trace.json")
+    parser.add_argument("--dumps", type=int, default=0,
+                        help="stop after this many dumps (0: until EOF)")
+    args = parser.parse_args()
+
+    converter = Converter()
+    with open_input(args.input) as f:
+        for channel, payload in frames(f):
+            if channel == CHANNEL_TRACE:
+                converter.feed(payload)
+            if args.dumps and converter.dumps >= args.dumps:
+                break
+
+    with open(args.output, "w") as out:
+        json.dump(converter.json(), out)
+
+
+if __name__ == "__main__":
+    main()
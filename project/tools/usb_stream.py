@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Splits the device's USB stdio into printf text and binary channels.
+
+Frames are USB_STREAM_SYNC | channel | length (LE16) | payload | checksum, see
+src/usb_stream.h. Everything outside a valid frame is regular text.
+
+    usb_stream.py /dev/ttyACM0 --replay-dir recordings/
+    usb_stream.py captured.bin --replay-dir recordings/
+"""
+
+import argparse
+import os
+import struct
+import sys
+import termios
+import tty
+
+SYNC = 0xA5
+MAX_PAYLOAD = 256
+
+CHANNEL_REPLAY = 1
+
+
+def open_input(path):
+    f = open(path, "rb", buffering=0)
+    if os.isatty(f.fileno()):
+        tty.setraw(f.fileno(), termios.TCSANOW)
+    return f
+
+
+def frames(f, on_text=None):
+    """Yields (channel, payload) for every valid frame read from f."""
+    buf = bytearray()
+    while True:
+        chunk = f.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        while buf:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                start = len(buf)
+            if start and on_text:
+                on_text(bytes(buf[:start]))
+            del buf[:start]
+
+            if len(buf) < 4:
+                break
+            channel = buf[1]
+            (length,) = struct.unpack_from("<H", buf, 2)
+            if length > MAX_PAYLOAD:
+                # Not a frame after all, the sync byte was just text
+                if on_text:
+                    on_text(bytes(buf[:1]))
+                del buf[:1]
+                continue
+            if len(buf) < 5 + length:
+                break
+
+            checksum = 0
+            for b in buf[1 : 4 + length]:
+                checksum ^= b
+            if checksum != buf[4 + length]:
+                if on_text:
+                    on_text(bytes(buf[:1]))
+                del buf[:1]
+                continue
+
+            yield channel, bytes(buf[4 : 4 + length])
+            del buf[: 5 + length]
+
+
+class ReplaySink:
+    """Reassembles input recordings, one file per recording generation."""
+
+    def __init__(self, directory):
+        self.directory = directory
+        self.recordings = {}
+        os.makedirs(directory, exist_ok=True)
+
+    def feed(self, payload):
+        generation = payload[0]
+        (offset,) = struct.unpack_from("<I", payload, 1)
+        data = payload[5:]
+
+        recording = self.recordings.setdefault(generation, bytearray())
+        if offset > len(recording):
+            recording.extend(bytes(offset - len(recording)))
+        recording[offset : offset + len(data)] = data
+
+        path = os.path.join(self.directory, "replay-%03d.bin" % generation)
+        with open(path, "wb") as out:
+            out.write(recording)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="serial device or captured stream")
+    parser.add_argument("--replay-dir", help="where to write input recordings")
+    args = parser.parse_args()
+
+    replay = ReplaySink(args.replay_dir) if args.replay_dir else None
+
+    def on_text(text):
+        sys.stdout.write(text.decode("ascii", "replace"))
+        sys.stdout.flush()
+
+    with open_input(args.input) as f:
+        for channel, payload in frames(f, on_text):
+            if channel == CHANNEL_REPLAY and replay:
+                replay.feed(payload)
+
+
+if __name__ == "__main__":
+    main()